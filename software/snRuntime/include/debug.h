@@ -33,6 +33,24 @@ extern "C" {
 
 #endif  // defined(__SNRT_USE_TRACE)
 
+/**
+ * @brief Halt the calling core if `cond` does not hold. The message is only
+ * printed with tracing enabled. Compiled out with NDEBUG.
+ */
+#ifndef NDEBUG
+#define snrt_assert(cond, x...) \
+    do {                        \
+        if (!(cond)) {          \
+            snrt_trace(0, x);   \
+            snrt_exit(1);       \
+        }                       \
+    } while (0)
+#else
+#define snrt_assert(cond, x...) \
+    do {                        \
+    } while (0)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
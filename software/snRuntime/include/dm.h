@@ -6,6 +6,26 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+/**
+ * @brief Completion token of a queued transfer, see dm_wait_token
+ *
+ */
+typedef uint32_t dm_token_t;
+
+struct snrt_dma_sg_entry;
+
+/**
+ * @brief How a hart waits in dm_wait and dm_wait_token
+ *
+ */
+typedef enum {
+    // spin on the queue state, lowest latency for short transfers
+    DM_WAIT_POLL = 0,
+    // sleep in wfi until the DM core signals progress with a cluster-local
+    // interrupt, leaves the issue slots and L1 bandwidth to the other cores
+    DM_WAIT_WFI = 1,
+} dm_wait_mode_t;
+
 /**
  * @brief Init the data mover and load a pointer to the DM struct in to TLS.
  * Needs to be called by the DM itself and all harts that want to use the dm
@@ -29,14 +49,15 @@ void dm_exit(void);
 /**
  * @brief Queue an asynchronus memory copy. The transfer is not started unless
  * dm_start or dm_wait is issued
- * @details block only if DM queue is full
+ * @details block only if DM queue is full. Any number of harts may queue
+ * concurrently without taking a lock
  *
  * @param dest destination pointer
  * @param src source pointer
  * @param n number of bytes to copy
- * @return transfer ID
+ * @return completion token
  */
-void dm_memcpy_async(void *dest, const void *src, size_t n);
+dm_token_t dm_memcpy_async(void *dest, const void *src, size_t n);
 
 /**
  * @brief Queue an asynchronus memory copy. The transfer is not started unless
@@ -50,10 +71,47 @@ void dm_memcpy_async(void *dest, const void *src, size_t n);
  * @param dstrd outer destination stride
  * @param nreps number of repetitions in outer dimension
  * @param cfg DMA configuration
+ * @return completion token
  */
-void dm_memcpy2d_async(uint64_t src, uint64_t dst, uint32_t size,
-                       uint32_t sstrd, uint32_t dstrd, uint32_t nreps,
-                       uint32_t cfg);
+dm_token_t dm_memcpy2d_async(uint64_t src, uint64_t dst, uint32_t size,
+                             uint32_t sstrd, uint32_t dstrd, uint32_t nreps,
+                             uint32_t cfg);
+
+/**
+ * @brief Queue an asynchronus 3D memory copy, issued by the DM core as `nreps2`
+ * 2D transfers. The transfer is not started unless dm_start or dm_wait is
+ * issued
+ * @details block only if DM queue is full
+ *
+ * @param src source address
+ * @param dst destination address
+ * @param size size in inner dimension
+ * @param sstrd middle source stride
+ * @param dstrd middle destination stride
+ * @param nreps number of repetitions in middle dimension
+ * @param sstrd2 outer source stride
+ * @param dstrd2 outer destination stride
+ * @param nreps2 number of repetitions in outer dimension
+ * @param cfg DMA configuration
+ * @return completion token
+ */
+dm_token_t dm_memcpy3d_async(uint64_t src, uint64_t dst, uint32_t size,
+                             uint32_t sstrd, uint32_t dstrd, uint32_t nreps,
+                             uint32_t sstrd2, uint32_t dstrd2, uint32_t nreps2,
+                             uint32_t cfg);
+
+/**
+ * @brief Queue a list of memory copies as a single task. The transfer is not
+ * started unless dm_start or dm_wait is issued
+ * @details block only if DM queue is full. The DM core reads the list when
+ * it issues the task, so it must stay valid until the task has completed
+ *
+ * @param list scatter-gather entries
+ * @param n number of entries
+ * @return completion token
+ */
+dm_token_t dm_memcpy_sg_async(const struct snrt_dma_sg_entry *list,
+                              uint32_t n);
 
 /**
  * @brief Trigger the start of queued transfers and exit immediately
@@ -61,6 +119,34 @@ void dm_memcpy2d_async(uint64_t src, uint64_t dst, uint32_t size,
  */
 void dm_start(void);
 
+/**
+ * @brief Check whether a queued transfer has completed
+ *
+ * @param token completion token returned when queueing the transfer
+ * @return non-zero once the transfer and all transfers queued before it
+ * have completed
+ */
+int dm_done(dm_token_t token);
+
+/**
+ * @brief Start queued transfers and wait for one of them to complete
+ * @details Only waits for the given transfer and the ones queued before it,
+ * transfers queued later by other harts may still be in flight
+ *
+ * @param token completion token returned when queueing the transfer
+ */
+void dm_wait_token(dm_token_t token);
+
+/**
+ * @brief Select how the calling hart waits in dm_wait and dm_wait_token
+ * @details The mode is per hart and DM_WAIT_POLL by default. In DM_WAIT_WFI
+ * the hart uses the cluster-local interrupt, which must not be in use for
+ * anything else while it waits
+ *
+ * @param mode DM_WAIT_POLL or DM_WAIT_WFI
+ */
+void dm_set_wait_mode(dm_wait_mode_t mode);
+
 /**
  * @brief Wait for all DMA transfers to complete
  * @details
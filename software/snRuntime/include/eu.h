@@ -19,6 +19,14 @@ void eu_init(void);
  */
 void eu_exit(uint32_t core_idx);
 
+/**
+ * @brief Set the number of cycles idle workers poll for the next job before
+ * they sleep until woken by an interrupt, EU_SPIN_CYCLES by default
+ *
+ * @param cycles spin budget, 0 to sleep right away
+ */
+void eu_set_spin_budget(uint32_t cycles);
+
 /**
  * @brief Enter the event unit loop, never exits
  *
@@ -38,6 +46,24 @@ void eu_event_loop(uint32_t cluster_core_idx);
 int eu_dispatch_push(void (*fn)(void *, uint32_t), uint32_t argc, void *data,
                      uint32_t nthreads);
 
+/**
+ * @brief Queue a task on the calling core, to be run by it or stolen by
+ * another core in eu_task_run
+ *
+ * @param fn task function
+ * @param arg argument passed to `fn`
+ * @return 0 on success, -1 if the queue of the calling core is full
+ */
+int eu_task_push(void (*fn)(void *), void *arg);
+
+/**
+ * @brief Run one queued task, the newest of the calling core or else the
+ * oldest of another core
+ *
+ * @return 1 if a task was run, 0 if all queues were empty
+ */
+int eu_task_run(void);
+
 /**
  * @brief wait for all workers to idle
  * @param core_idx cluster-local core index
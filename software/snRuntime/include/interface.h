@@ -38,6 +38,17 @@ typedef struct ident {
                           of line numbers that delimit the construct. */
 } ident_t;
 
+/*!
+ * Values for bit flags used in the ident_t to describe the fields.
+ */
+/*! Compiler generates atomic reduction option for reduce clause */
+#define KMP_IDENT_ATOMIC_REDUCE 0x10
+
+/*!
+ * Lock passed to the reduction entry points, unused by this runtime.
+ */
+typedef kmp_int32 kmp_critical_name[8];
+
 /*!
  @ingroup WORK_SHARING
  * Describes the loop schedule to be used for a parallel for loop.
@@ -9,6 +9,27 @@
 
 typedef void (*kmpc_micro)(kmp_int32 *global_tid, kmp_int32 *bound_tid, ...);
 
+typedef kmp_int32 (*kmp_routine_entry_t)(kmp_int32, void *);
+
+/**
+ * @brief Explicit task as laid out by the compiler, followed by the private
+ * variables of the task
+ */
+typedef struct kmp_task {
+    void *shareds;
+    kmp_routine_entry_t routine;
+    kmp_int32 part_id;
+} kmp_task_t;
+
+/**
+ * @brief Usually the arguments passed to __kmpc_fork_call would to a malloc
+ * with the amount of arguments passed. This is too slow for our case and thus
+ * we reserve a chunk of arguments in TCDM and use it. Forks with more
+ * arguments allocate a buffer for the duration of the parallel region
+ *
+ */
+#define KMP_FORK_MAX_NARGS 12
+
 extern _kmp_ptr32 *kmpc_args;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -59,13 +59,25 @@
 typedef struct {
     char nbThreads;
 #ifndef OMPSTATIC_NUMTHREADS
+    // Dynamic scheduling: loop `loop_epoch` is published, `loop_claim` is the
+    // loop being set up, `core_epoch` the last loop each thread entered
     int loop_epoch;
-    int loop_start;
-    int loop_end;
-    int loop_incr;
-    int loop_chunk;
-    int loop_is_setup;
-    int core_epoch[16];  // for dynamic scheduling
+    int loop_claim;
+    // 64-bit to serve the 4 and 8 byte entry points alike
+    uint64_t loop_start;
+    int64_t loop_incr;
+    // index of the last iteration, the trip count of a full 64-bit range
+    // does not fit
+    uint64_t loop_last;
+    // iterations per chunk and number of chunks
+    uint64_t loop_chunk;
+    unsigned loop_nchunks;
+    int loop_sched;
+    // chunks handed out so far
+    unsigned loop_next;
+    // threads that did not yet run out of chunks
+    unsigned loop_left;
+    int core_epoch[SNRT_CLUSTER_MAX_CORES];
 #endif
 } omp_team_t;
 
@@ -81,15 +93,19 @@ typedef struct {
 #endif
     /**
      * @brief Pointer to the barrier register used for synchronization eg with
-     * #pragma omp barrier
+     * #pragma omp barrier. A sense-reversing barrier with OMP_SENSE_BARRIER.
      *
      */
+#ifdef OMP_SENSE_BARRIER
+    struct snrt_sense_barrier *kmpc_barrier;
+#else
     struct snrt_barrier *kmpc_barrier;
+#endif
     /**
      * @brief Usually the arguments passed to __kmpc_fork_call would do a malloc
      * with the amount of arguments passed. This is too slow for our case and
-     * thus we reserve a chunk of arguments in TCDM and use it. This limits the
-     * maximum number of arguments
+     * thus we reserve a chunk of KMP_FORK_MAX_NARGS arguments in TCDM and use
+     * it
      */
     _kmp_ptr32 *kmpc_args;
 } omp_t;
@@ -107,6 +123,9 @@ extern __thread omp_t volatile *omp_p;
 extern omp_t omp_p;
 #endif
 
+/// Nesting depth of the parallel regions of this thread, see kmp.c
+extern __thread uint32_t kmp_level;
+
 //================================================================================
 // exported
 //================================================================================
@@ -137,8 +156,16 @@ static inline const omp_team_t *omp_get_team(const omp_t *_this) {
 }
 #endif
 
+/// Thread number in the innermost team, zero outside of parallel regions and
+/// in a serialized nested one
 static inline unsigned omp_get_thread_num(void) {
-    return snrt_cluster_core_idx();
+    return kmp_level == 1 ? snrt_cluster_core_idx() : 0;
+}
+
+/// Size of the innermost team, one outside of parallel regions and in a
+/// serialized nested one
+static inline unsigned omp_get_num_threads(void) {
+    return kmp_level == 1 ? (unsigned)omp_getData()->numThreads : 1;
 }
 
 static inline void __attribute__((always_inline))
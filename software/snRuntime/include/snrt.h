@@ -31,11 +31,24 @@ extern "C" {
 #define snrt_max(a, b) ((a) > (b) ? (a) : (b))
 #endif
 
-inline static void *snrt_memset(void *ptr, int value, size_t num) {
-    for (uint32_t i = 0; i < num; ++i)
-        *((uint8_t *)ptr + i) = (unsigned char)value;
-    return ptr;
-}
+/// L1 data cacheline width in bits, set by the L1D_CACHELINE_WIDTH CMake option
+#ifndef SNRT_L1D_CACHELINE_WIDTH
+#define SNRT_L1D_CACHELINE_WIDTH 512
+#endif
+#define SNRT_L1D_CACHELINE_BYTES (SNRT_L1D_CACHELINE_WIDTH / 8)
+
+/// Upper bound of cores per cluster, sizes statically allocated per-core state
+#ifndef SNRT_CLUSTER_MAX_CORES
+#define SNRT_CLUSTER_MAX_CORES 16
+#endif
+
+/// Fills of at least this many bytes use the vector unit, must cover the
+/// alignment head of up to one cacheline
+#ifndef SNRT_MEMSET_VEC_MIN
+#define SNRT_MEMSET_VEC_MIN (2 * SNRT_L1D_CACHELINE_BYTES)
+#endif
+
+extern void *snrt_memset(void *ptr, int value, size_t num);
 
 /// A slice of memory.
 typedef struct snrt_slice {
@@ -60,12 +73,38 @@ struct snrt_barrier {
     uint32_t volatile barrier_iteration;
 };
 
+/// Release flag of one core, padded to its own cacheline
+struct snrt_barrier_flag {
+    uint32_t volatile sense;
+} __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES)));
+
+/// Barrier to use with snrt_sense_barrier, zero-initialized
+struct snrt_sense_barrier {
+    struct snrt_barrier_flag flag[SNRT_CLUSTER_MAX_CORES];
+    uint32_t volatile count __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES)));
+};
+
+/// Subset of the cores of a cluster, see snrt_subteam_init_mask
+struct snrt_subteam {
+    uint32_t mask;  // bit `i` is set if cluster core `i` is a member
+    uint32_t num;   // number of members
+    struct snrt_sense_barrier barrier;
+};
+
 static inline size_t snrt_slice_len(snrt_slice_t s) { return s.end - s.start; }
 
 extern void snrt_cluster_hw_barrier();
 extern void snrt_cluster_sw_barrier();
 extern void snrt_global_barrier();
 extern void snrt_barrier(struct snrt_barrier *barr, uint32_t n);
+extern void snrt_sense_barrier(struct snrt_sense_barrier *barr, uint32_t n);
+extern void snrt_subteam_init_mask(struct snrt_subteam *team, uint32_t mask);
+extern void snrt_subteam_init_range(struct snrt_subteam *team, uint32_t first,
+                                    uint32_t num);
+extern int snrt_subteam_is_member(const struct snrt_subteam *team);
+extern void snrt_subteam_barrier(struct snrt_subteam *team);
+extern uint32_t snrt_barrier_arrive();
+extern void snrt_barrier_wait(uint32_t token);
 
 static inline uint32_t __attribute__((pure)) snrt_hartid();
 struct snrt_team_root *snrt_current_team();
@@ -103,7 +142,36 @@ extern snrt_slice_t snrt_cluster_memory();
 extern void snrt_bcast_send(void *data, size_t len);
 extern void snrt_bcast_recv(void *data, size_t len);
 
+/// Copies of at least this many bytes use the vector unit
+#ifndef SNRT_MEMCPY_VEC_MIN
+#define SNRT_MEMCPY_VEC_MIN SNRT_L1D_CACHELINE_BYTES
+#endif
+/// Copies of at least this many bytes use the DMA on a core with the DMA
+/// extension, 0 disables it. Each DMA copy flushes the whole L1 data cache,
+/// so only copies far beyond its cost are worth it.
+#ifndef SNRT_MEMCPY_DMA_MIN
+#define SNRT_MEMCPY_DMA_MIN (512 * SNRT_L1D_CACHELINE_BYTES)
+#endif
+
 extern void *snrt_memcpy(void *dst, const void *src, size_t n);
+extern void *snrt_vmemcpy(void *dst, const void *src, size_t n);
+
+/// Place a variable in UNCACHED_REGION, its accesses bypass the L1 data cache
+#define SNRT_UNCACHED __attribute__((section(".uncached")))
+
+/// Route of a bulk copy, see snrt_memcpy_stream
+enum snrt_stream_mode {
+    /// Through the L1 data cache, same as snrt_memcpy
+    SNRT_STREAM_CACHED = 0,
+    /// Vector copy between buffers of which at least one is uncached
+    SNRT_STREAM_UNCACHED = 1,
+    /// By the DMA, queued to the DM core on cores without the DMA extension
+    SNRT_STREAM_DMA = 2,
+};
+
+extern int snrt_is_uncached(const void *ptr);
+extern void *snrt_memcpy_stream(void *dst, const void *src, size_t n,
+                                enum snrt_stream_mode mode);
 
 /// DMA runtime functions.
 /// A DMA transfer identifier.
@@ -123,11 +191,63 @@ extern snrt_dma_txid_t snrt_dma_start_2d_wideptr(uint64_t dst, uint64_t src,
 extern snrt_dma_txid_t snrt_dma_start_2d(void *dst, const void *src,
                                          size_t size, size_t dst_stride,
                                          size_t src_stride, size_t repeat);
+/// Initiate an asynchronous 3D DMA transfer as a chain of 2D transfers.
+extern snrt_dma_txid_t snrt_dma_start_3d(void *dst, const void *src,
+                                         size_t size, size_t dst_stride,
+                                         size_t src_stride, size_t repeat,
+                                         size_t dst_stride_3d,
+                                         size_t src_stride_3d,
+                                         size_t repeat_3d);
+/// Entry of a scatter-gather list
+struct snrt_dma_sg_entry {
+    const void *src;
+    void *dst;
+    size_t size;
+};
+/// Initiate the 1D DMA transfers of a scatter-gather list.
+extern snrt_dma_txid_t snrt_dma_start_sg(const struct snrt_dma_sg_entry *list,
+                                         uint32_t n);
 /// Block until a transfer finishes.
 extern void snrt_dma_wait(snrt_dma_txid_t tid);
 /// Block until all operation on the DMA ceases.
 extern void snrt_dma_wait_all();
 
+/// Maximum number of buffers of a DMA pipeline, i.e. triple buffering
+#define SNRT_DMA_PIPELINE_MAX_BUFS 3
+
+/// Called on every tile of a DMA pipeline, `buf` holds the tile packed row
+/// after row
+typedef void (*snrt_dma_pipeline_fn)(void *buf, uint32_t tile, void *arg);
+
+/**
+ * @brief Multi-buffered 2D DMA pipeline, see snrt_dma_pipeline_run
+ * @details Tile `i` is the 2D block of `repeat` rows of `size` bytes at
+ * `src + i * src_tile_stride`, rows `src_stride` bytes apart. If `dst` is
+ * set, the buffer is written back to `dst + i * dst_tile_stride` after
+ * compute, rows `dst_stride` bytes apart.
+ */
+struct snrt_dma_pipeline {
+    const void *src;
+    void *dst;
+    size_t src_tile_stride;
+    size_t dst_tile_stride;
+    // Tile shape
+    size_t size;
+    size_t src_stride;
+    size_t dst_stride;
+    size_t repeat;
+    uint32_t num_tiles;
+    // `num_bufs` buffers, 2 to SNRT_DMA_PIPELINE_MAX_BUFS, of `size * repeat`
+    // bytes each, e.g. from snrt_l1alloc or the scratchpad partition set with
+    // l1d_spm_config
+    void *buf[SNRT_DMA_PIPELINE_MAX_BUFS];
+    uint32_t num_bufs;
+    snrt_dma_pipeline_fn compute;
+    void *arg;
+};
+
+extern int snrt_dma_pipeline_run(const struct snrt_dma_pipeline *p);
+
 /**
  * @brief Use as replacement of the stdlib exit() call
  *
@@ -152,10 +272,43 @@ static inline uint32_t __attribute__((pure)) snrt_hartid() {
 //================================================================================
 // Allocation functions
 //================================================================================
+/// Alignment and granularity of L1 allocations, one cacheline by default. A
+/// smaller power of two of at least 8 bytes packs small objects tighter at the
+/// cost of false sharing between them.
+#ifndef SNRT_L1_ALLOC_ALIGN
+#define SNRT_L1_ALLOC_ALIGN SNRT_L1D_CACHELINE_BYTES
+#endif
+/// Number of L1 size classes, one per block size of 1 to 8 granules
+#define SNRT_L1_ALLOC_NUM_BINS 8
+/// Maximum size of the private L1 arena of each core in lines, see
+/// snrt_alloc_init
+#ifndef SNRT_L1_ARENA_LINES
+#define SNRT_L1_ARENA_LINES 4
+#endif
+
+/// Checkpoint of the L1 allocator, see snrt_l1_mark
+typedef struct {
+    uint32_t arena;  // top of the calling core's arena
+    uint32_t pool;   // top of the shared pool
+} snrt_l1_mark_t;
+
 extern void snrt_alloc_init(struct snrt_team_root *team, uint32_t l3off);
 extern void *snrt_l1alloc(size_t size);
+extern void snrt_l1free(void *ptr);
 extern void *snrt_l3alloc(size_t size);
+extern void snrt_l3free(void *ptr);
+extern size_t snrt_l3alloc_peak();
+extern void *snrt_l1alloc_banked(size_t size, uint32_t tile,
+                                 uint32_t bank_mask);
+extern void snrt_l1free_banked(void *ptr);
+extern uint32_t snrt_l1d_bank(const void *ptr);
 extern void snrt_l1alloc_reset();
+/// Regions of L1 allocations, see snrt_l1_release. The pool blocks of a
+/// region are only reclaimed if no other core bumped the shared pool since
+/// the mark. Otherwise they leak until snrt_l1alloc_reset, which
+/// snrt_l1_release asserts against.
+extern snrt_l1_mark_t snrt_l1_mark();
+extern void snrt_l1_release(snrt_l1_mark_t mark);
 
 //================================================================================
 // Interrupt functions
@@ -21,9 +21,37 @@ struct snrt_allocator_inst {
     // Address of the next allocated block
     uint32_t next;
 };
+// Per-core L1 arena. Only its owner allocates from and frees into it, so no
+// synchronization is needed. Padded to a cacheline to avoid false sharing.
+struct snrt_l1_arena {
+    // Private bump region of the core
+    struct snrt_allocator_inst inst;
+    // Head of the free list of each size class. Bin `i` holds free blocks of
+    // `(i + 1) * SNRT_L1_ALLOC_ALIGN` bytes
+    uint32_t free[SNRT_L1_ALLOC_NUM_BINS];
+    // Head of the free list of blocks beyond the biggest size class
+    uint32_t large;
+    // Pool blocks the core bumped back to back span [pool_run, pool_top)
+    uint32_t pool_run;
+    uint32_t pool_top;
+} __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES)));
+
 struct snrt_allocator {
+    // Shared L1 pool, bumped atomically once a core's arena is exhausted
     struct snrt_allocator_inst l1;
     struct snrt_allocator_inst l3;
+    // Descriptors of the per-core L1 arenas, indexed by the cluster-local
+    // core index
+    struct snrt_l1_arena *l1_arena;
+    // Block size in cachelines, indexed by the block's first cacheline
+    // counted from `l1_lines_base`
+    uint16_t *l1_lines;
+    uint32_t l1_lines_base;
+    // Free blocks of the L3 heap, sorted by address
+    uint32_t l3_free;
+    // Highest address the L3 heap has reached
+    uint32_t l3_peak;
+    volatile uint32_t l3_mutex;
 };
 
 // This struct is placed at the end of each clusters TCDM
@@ -1,6 +1,7 @@
 // Copyright 2020 ETH Zurich and University of Bologna.
 // Licensed under the Apache License, Version 2.0, see LICENSE for details.
 // SPDX-License-Identifier: Apache-2.0
+#include "cachepool_peripheral.h"
 #include "debug.h"
 #include "snrt.h"
 #include "team.h"
@@ -10,77 +11,540 @@
 
 #define MIN_CHUNK_SIZE 8
 
+/// Per-core L1 arena descriptors, kept in .bss so they take no L1 memory
+static struct snrt_l1_arena l1_arenas[SNRT_CLUSTER_MAX_CORES];
+
+//================================================================================
+// L1 size classes
+//================================================================================
+
+static inline struct snrt_l1_arena *l1_arena(struct snrt_allocator *alloc) {
+    return &alloc->l1_arena[snrt_cluster_core_idx()];
+}
+
+/// Size in cachelines of the block starting at `blk`
+static inline uint16_t *l1_lines(struct snrt_allocator *alloc, uint32_t blk) {
+    return &alloc->l1_lines[(blk - alloc->l1_lines_base) / SNRT_L1_ALLOC_ALIGN];
+}
+
+/// Size class serving blocks of exactly `nlines` cachelines
+static inline uint32_t l1_bin(uint32_t nlines) { return nlines - 1; }
+
+/// Pop a free block of at least `nlines` cachelines from the large list
+static uint32_t l1_large_pop(struct snrt_allocator *alloc,
+                             struct snrt_l1_arena *arena, uint32_t nlines) {
+    uint32_t *prev = &arena->large;
+    // First fit, blocks in here are rare and big
+    for (uint32_t blk = *prev; blk; blk = *(uint32_t *)blk) {
+        if (*l1_lines(alloc, blk) >= nlines) {
+            *prev = *(uint32_t *)blk;
+            return blk;
+        }
+        prev = (uint32_t *)blk;
+    }
+    return 0;
+}
+
+/// Bump `bytes` off the shared pool, lock-free
+static uint32_t l1_pool_bump(struct snrt_allocator_inst *pool,
+                             uint32_t bytes) {
+    uint32_t ret = __atomic_load_n(&pool->next, __ATOMIC_RELAXED);
+    do {
+        if (ret + bytes > pool->base + pool->size) return 0;
+    } while (!__atomic_compare_exchange_n(&pool->next, &ret, ret + bytes, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return ret;
+}
+
 /**
  * @brief Allocate a chunk of memory in the L1 memory
- * @details This currently does not support free-ing of memory
+ * @details Requests are rounded up to whole lines of SNRT_L1_ALLOC_ALIGN
+ * bytes, cachelines by default. Blocks of up to SNRT_L1_ALLOC_NUM_BINS lines
+ * have a free list per size and are served from it in O(1). Only if the list
+ * is empty, the block is carved from the calling core's arena, and once that
+ * is exhausted from the shared pool. Bigger blocks are kept in a single
+ * first-fit list. None of the paths takes a lock.
  *
  * @param size number of bytes to allocate
- * @return pointer to the allocated memory
+ * @return pointer to memory aligned to SNRT_L1_ALLOC_ALIGN, 0 if out of memory
  */
 void *snrt_l1alloc(size_t size) {
-    struct snrt_allocator_inst *alloc = &snrt_current_team()->allocator.l1;
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
+    struct snrt_l1_arena *arena = l1_arena(alloc);
 
-    size = ALIGN_UP(size, MIN_CHUNK_SIZE);
+    uint32_t nlines = (snrt_max(size, 1) + SNRT_L1_ALLOC_ALIGN - 1) /
+                      SNRT_L1_ALLOC_ALIGN;
+    uint32_t bin = l1_bin(nlines);
+    uint32_t ret;
 
-    if (alloc->next + size > alloc->base + alloc->size) {
-        snrt_trace(
-            SNRT_TRACE_ALLOC,
-            "Not enough memory to allocate: base %#x size %#x next %#x\n",
-            alloc->base, alloc->size, alloc->next);
-        return 0;
+    if (bin < SNRT_L1_ALLOC_NUM_BINS) {
+        ret = arena->free[bin];
+        if (ret) {
+            arena->free[bin] = *(uint32_t *)ret;
+            return (void *)ret;
+        }
+    } else {
+        ret = l1_large_pop(alloc, arena, nlines);
+        if (ret) return (void *)ret;
     }
 
-    void *ret = (void *)alloc->next;
-    alloc->next += size;
-    return ret;
+    uint32_t bytes = nlines * SNRT_L1_ALLOC_ALIGN;
+    if (arena->inst.next + bytes <= arena->inst.base + arena->inst.size) {
+        ret = arena->inst.next;
+        arena->inst.next += bytes;
+    } else {
+        ret = l1_pool_bump(&alloc->l1, bytes);
+        if (!ret) {
+            snrt_trace(
+                SNRT_TRACE_ALLOC,
+                "Not enough memory to allocate: base %#x size %#x next %#x\n",
+                alloc->l1.base, alloc->l1.size, alloc->l1.next);
+            return 0;
+        }
+        // Another core bumped in between, start a new run
+        if (ret != arena->pool_top) arena->pool_run = ret;
+        arena->pool_top = ret + bytes;
+    }
+
+    *l1_lines(alloc, ret) = nlines;
+    return (void *)ret;
+}
+
+/**
+ * @brief Return a chunk allocated with snrt_l1alloc to the L1 memory
+ * @details The block goes to the free list of its size class in the calling
+ * core's arena, which need not be the arena it was allocated from. The block
+ * on top of the arena or the shared pool is handed back to it directly.
+ *
+ * @param ptr pointer returned by snrt_l1alloc, may be 0
+ */
+void snrt_l1free(void *ptr) {
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
+    struct snrt_l1_arena *arena = l1_arena(alloc);
+    uint32_t blk = (uint32_t)ptr;
+
+    if (!blk) return;
+    if (blk < alloc->l1_arena[0].inst.base ||
+        blk >= alloc->l1.base + alloc->l1.size ||
+        blk & (SNRT_L1_ALLOC_ALIGN - 1)) {
+        snrt_trace(SNRT_TRACE_ALLOC, "Free of foreign pointer %#x\n", blk);
+        return;
+    }
+
+    uint32_t nlines = *l1_lines(alloc, blk);
+    uint32_t end = blk + nlines * SNRT_L1_ALLOC_ALIGN;
+    uint32_t bin = l1_bin(nlines);
+
+    if (blk >= arena->inst.base && end == arena->inst.next) {
+        arena->inst.next = blk;
+    } else if (blk >= alloc->l1.base &&
+               __atomic_compare_exchange_n(&alloc->l1.next, &end, blk, 0,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED)) {
+        if (end == arena->pool_top) arena->pool_top = blk;
+        return;
+    } else if (bin >= SNRT_L1_ALLOC_NUM_BINS) {
+        *(uint32_t *)blk = arena->large;
+        arena->large = blk;
+    } else {
+        *(uint32_t *)blk = arena->free[bin];
+        arena->free[bin] = blk;
+    }
 }
 
 /**
  * @brief Free all allocated region in L1 memory
- * @details We'd better free all regions beore reconfiguring
+ * @details We'd better free all regions beore reconfiguring. This drops the
+ * arenas of all cores, so none of them may allocate concurrently.
  */
 void snrt_l1alloc_reset() {
-    struct snrt_allocator_inst *alloc = &snrt_current_team()->allocator.l1;
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
     // Reset next pointer to base
-    alloc->next = alloc->base;
+    alloc->l1.next = alloc->l1.base;
+    // Drop all free lists, their blocks are part of the pool again
+    for (uint32_t c = 0; c < snrt_cluster_core_num(); c++) {
+        struct snrt_l1_arena *arena = &alloc->l1_arena[c];
+        arena->inst.next = arena->inst.base;
+        for (uint32_t i = 0; i < SNRT_L1_ALLOC_NUM_BINS; i++)
+            arena->free[i] = 0;
+        arena->large = 0;
+        arena->pool_run = 0;
+        arena->pool_top = 0;
+    }
+}
+
+/// Drop the blocks of a free list that lie above a checkpoint
+static void l1_list_release(uint32_t *link, struct snrt_l1_arena *arena,
+                            snrt_l1_mark_t mark) {
+    uint32_t arena_end = arena->inst.base + arena->inst.size;
+    while (*link) {
+        uint32_t blk = *link;
+        if ((blk >= mark.arena && blk < arena_end) || blk >= mark.pool)
+            *link = *(uint32_t *)blk;
+        else
+            link = (uint32_t *)blk;
+    }
+}
+
+/**
+ * @brief Checkpoint the L1 allocations of the calling core
+ * @details Records the top of the calling core's arena and of the shared
+ * pool. Pair with snrt_l1_release to drop everything allocated in between.
+ *
+ * @return checkpoint to pass to snrt_l1_release
+ */
+snrt_l1_mark_t snrt_l1_mark() {
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
+    snrt_l1_mark_t mark = {
+        .arena = l1_arena(alloc)->inst.next,
+        .pool = __atomic_load_n(&alloc->l1.next, __ATOMIC_RELAXED),
+    };
+    return mark;
+}
+
+/**
+ * @brief Roll the L1 allocations back to a checkpoint
+ * @details All blocks allocated since `mark` are released at once, without
+ * freeing them one by one. The arena and pool tops are reset in O(1), the
+ * calling core's free lists are only walked to drop blocks above the
+ * checkpoint. Regions nest like a stack.
+ *
+ * Other cores may allocate concurrently. The shared pool is only rolled back
+ * if all of it above the checkpoint was bumped by the calling core, and its
+ * top is reset with a CAS from the calling core's last block. Otherwise the
+ * pool blocks of the region leak until snrt_l1alloc_reset, which is asserted
+ * against: regions that use the shared pool need the other cores to not
+ * allocate from it meanwhile. Blocks of the region must not be freed by
+ * another core, they would be left in its free lists.
+ *
+ * @param mark checkpoint returned by snrt_l1_mark on the same core
+ */
+void snrt_l1_release(snrt_l1_mark_t mark) {
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
+    struct snrt_l1_arena *arena = l1_arena(alloc);
+    uint32_t top = arena->pool_top;
+
+    if (mark.arena < arena->inst.next) arena->inst.next = mark.arena;
+    if (mark.pool < top && arena->pool_run <= mark.pool &&
+        __atomic_compare_exchange_n(&alloc->l1.next, &top, mark.pool, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        arena->pool_top = mark.pool;
+    } else {
+        snrt_assert(mark.pool >= top,
+                    "Pool shared since mark %#x, region leaks until reset\n",
+                    mark.pool);
+        // Keep the pool blocks in the free lists, they are still allocated
+        mark.pool = alloc->l1.base + alloc->l1.size;
+    }
+
+    for (uint32_t i = 0; i < SNRT_L1_ALLOC_NUM_BINS; i++)
+        l1_list_release(&arena->free[i], arena, mark);
+    l1_list_release(&arena->large, arena, mark);
 }
 
+//================================================================================
+// L3 heap
+//================================================================================
+
+/// Header in front of every L3 block, `next` is only valid while it is free
+struct l3_block {
+    // Size of the block including the header
+    uint32_t size;
+    uint32_t next;
+};
+
 /**
  * @brief Allocate a chunk of memory in the L3 memory
- * @details This currently does not support free-ing of memory
+ * @details First fit from the free list, otherwise the block is carved from
+ * the top of the heap. The heap is bounded by the linker script and the global
+ * memory end reported in the bootdata.
  *
  * @param size number of bytes to allocate
- * @return pointer to the allocated memory
+ * @return pointer to the allocated memory, 0 if out of memory
  */
 void *snrt_l3alloc(size_t size) {
-    struct snrt_allocator_inst *alloc = &snrt_current_team()->allocator.l3;
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
+    struct l3_block *blk = 0;
 
-    // TODO: L3 alloc size check
+    if (size > alloc->l3.size) return 0;
+    uint32_t bytes = ALIGN_UP(size, MIN_CHUNK_SIZE) + sizeof(struct l3_block);
 
-    void *ret = (void *)alloc->next;
-    alloc->next += size;
-    return ret;
+    snrt_mutex_lock(&alloc->l3_mutex);
+
+    for (uint32_t *link = &alloc->l3_free; *link;
+         link = &((struct l3_block *)*link)->next) {
+        struct l3_block *cand = (struct l3_block *)*link;
+        if (cand->size < bytes) continue;
+        if (cand->size - bytes >= sizeof(struct l3_block) + MIN_CHUNK_SIZE) {
+            // Split, the tail stays in the free list
+            struct l3_block *tail = (struct l3_block *)((uint32_t)cand + bytes);
+            tail->size = cand->size - bytes;
+            tail->next = cand->next;
+            cand->size = bytes;
+            *link = (uint32_t)tail;
+        } else {
+            *link = cand->next;
+        }
+        blk = cand;
+        break;
+    }
+
+    if (!blk) {
+        if (alloc->l3.next + bytes > alloc->l3.base + alloc->l3.size) {
+            snrt_mutex_release(&alloc->l3_mutex);
+            snrt_trace(
+                SNRT_TRACE_ALLOC,
+                "Not enough memory to allocate: base %#x size %#x next %#x\n",
+                alloc->l3.base, alloc->l3.size, alloc->l3.next);
+            return 0;
+        }
+        blk = (struct l3_block *)alloc->l3.next;
+        blk->size = bytes;
+        alloc->l3.next += bytes;
+        alloc->l3_peak = snrt_max(alloc->l3_peak, alloc->l3.next);
+    }
+
+    snrt_mutex_release(&alloc->l3_mutex);
+    return blk + 1;
+}
+
+/**
+ * @brief Return a chunk allocated with snrt_l3alloc to the L3 memory
+ * @details The block is merged with its free neighbours. A free block on top
+ * of the heap shrinks the heap.
+ *
+ * @param ptr pointer returned by snrt_l3alloc, may be 0
+ */
+void snrt_l3free(void *ptr) {
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
+    struct l3_block *left = 0;
+    uint32_t *link = &alloc->l3_free, *left_link = 0;
+
+    if (!ptr) return;
+    struct l3_block *blk = (struct l3_block *)ptr - 1;
+
+    snrt_mutex_lock(&alloc->l3_mutex);
+
+    // Find the free neighbours in the address sorted list
+    while (*link && *link < (uint32_t)blk) {
+        left_link = link;
+        left = (struct l3_block *)*link;
+        link = &left->next;
+    }
+    blk->next = *link;
+    *link = (uint32_t)blk;
+
+    if (blk->next == (uint32_t)blk + blk->size) {
+        struct l3_block *right = (struct l3_block *)blk->next;
+        blk->size += right->size;
+        blk->next = right->next;
+    }
+    if (left && (uint32_t)left + left->size == (uint32_t)blk) {
+        left->size += blk->size;
+        left->next = blk->next;
+        blk = left;
+        link = left_link;
+    }
+    if ((uint32_t)blk + blk->size == alloc->l3.next) {
+        *link = blk->next;
+        alloc->l3.next = (uint32_t)blk;
+    }
+
+    snrt_mutex_release(&alloc->l3_mutex);
+}
+
+/**
+ * @brief High-water mark of the L3 heap
+ *
+ * @return maximum number of bytes the L3 heap occupied since init
+ */
+size_t snrt_l3alloc_peak() {
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
+    return alloc->l3_peak - alloc->l3.base;
+}
+
+//================================================================================
+// L1D bank placement
+//================================================================================
+
+/// Current L1D crossbar mapping, read back from the cluster peripherals
+struct l1d_map {
+    uint32_t offset;     // first address bit of the bank field
+    uint32_t bank_bits;  // log2 of the cache banks per tile
+    uint32_t tile_bits;  // log2 of the tiles
+    uint32_t nprivate;   // private banks per tile
+    uint32_t private_start;
+};
+
+static void l1d_map_get(struct l1d_map *map) {
+    uint32_t periph = (uint32_t)snrt_current_team()->cluster_mem.end;
+    uint32_t tiles = snrt_cluster_tile_num();
+    map->offset = *(volatile uint32_t *)(periph +
+                                         CACHEPOOL_PERIPHERAL_XBAR_OFFSET_REG_OFFSET) &
+                  CACHEPOOL_PERIPHERAL_XBAR_OFFSET_OFFSET_MASK;
+    map->nprivate = *(volatile uint32_t *)(periph +
+                                           CACHEPOOL_PERIPHERAL_L1D_PRIVATE_REG_OFFSET) &
+                    CACHEPOOL_PERIPHERAL_L1D_PRIVATE_NUMBER_MASK;
+    map->private_start =
+        *(volatile uint32_t *)(periph + CACHEPOOL_PERIPHERAL_L1D_ADDR_REG_OFFSET);
+    map->bank_bits = __builtin_ctz(snrt_cluster_core_num() / tiles);
+    map->tile_bits = __builtin_ctz(tiles);
+}
+
+/**
+ * @brief L1D bank an address is cached in
+ * @details Follows the routing of the cache crossbar: shared addresses are
+ * cached on the tile selected by the tile bits, private ones on the tile of
+ * the calling core. Within the tile, private addresses use the first
+ * `L1D_PRIVATE` banks and shared addresses the remaining ones.
+ *
+ * @param ptr address to look up
+ * @return bank index within the cluster, i.e. `tile * banks_per_tile + bank`
+ */
+uint32_t snrt_l1d_bank(const void *ptr) {
+    struct l1d_map map;
+    l1d_map_get(&map);
+    uint32_t addr = (uint32_t)ptr;
+    uint32_t nbanks = 1 << map.bank_bits;
+    uint32_t bank = (addr >> map.offset) & (nbanks - 1);
+    uint32_t tile = (addr >> (map.offset + map.bank_bits)) &
+                    ((1 << map.tile_bits) - 1);
+
+    if (map.nprivate >= nbanks || !map.tile_bits) {
+        tile = snrt_cluster_tile_idx();
+    } else if (map.nprivate && addr >= map.private_start) {
+        tile = snrt_cluster_tile_idx();
+        bank %= map.nprivate;
+    } else if (map.nprivate) {
+        bank = map.nprivate + bank % (nbanks - map.nprivate);
+    }
+    return (tile << map.bank_bits) | bank;
+}
+
+/**
+ * @brief Allocate a chunk of memory starting on chosen L1D banks
+ * @details The L1D caches the L3 memory, so the chunk is taken from the L3
+ * heap and placed such that, with the current xbar offset and partitioning,
+ * its first byte is cached on the lowest bank of `bank_mask` in `tile` that
+ * the address can reach. The following `2^offset` byte granules walk the
+ * banks upwards, so a chunk of up to `n << offset` bytes stays on the `n`
+ * consecutive banks starting there. Tiles only matter for shared addresses,
+ * private ones are always cached on the tile of the accessing core. The
+ * placement is only valid until the xbar offset or partitioning changes.
+ *
+ * @param size number of bytes to allocate
+ * @param tile tile to place the chunk on
+ * @param bank_mask bit mask of the allowed banks within the tile
+ * @return pointer to the allocated memory, or 0 if no allowed bank is
+ * reachable or the L3 heap is exhausted
+ */
+void *snrt_l1alloc_banked(size_t size, uint32_t tile, uint32_t bank_mask) {
+    struct snrt_allocator *alloc = &snrt_current_team()->allocator;
+    struct l1d_map map;
+    l1d_map_get(&map);
+    uint32_t nbanks = 1 << map.bank_bits;
+    uint32_t shift = map.offset + map.bank_bits + map.tile_bits;
+    uint32_t period = 1 << shift;
+
+    bank_mask &= nbanks - 1;
+    if (!bank_mask || tile >> map.tile_bits) return 0;
+    // Over-allocate by one full interleaving period and remember the start
+    // of the L3 block right in front of the returned chunk
+    if (shift >= 32 || period > alloc->l3.size ||
+        size > alloc->l3.size - period)
+        return 0;
+    uint32_t raw = (uint32_t)snrt_l3alloc(size + period + sizeof(uint32_t));
+    if (!raw) return 0;
+
+    // Bank field value that routes to the lowest reachable bank in the mask
+    uint32_t sel = nbanks;
+    for (uint32_t b = 0; b < nbanks && sel == nbanks; b++) {
+        if (!(bank_mask & (1 << b))) continue;
+        if (map.nprivate >= nbanks || !map.tile_bits || !map.nprivate)
+            sel = b;
+        else if (raw >= map.private_start)
+            sel = b < map.nprivate ? b : nbanks;
+        else
+            sel = b >= map.nprivate ? b - map.nprivate : nbanks;
+    }
+    if (sel == nbanks) {
+        snrt_l3free((void *)raw);
+        return 0;
+    }
+
+    uint32_t phase = ((tile << map.bank_bits) | sel) << map.offset;
+    uint32_t ret = raw + sizeof(uint32_t);
+    ret = ALIGN_UP(ret - phase, period) + phase;
+    ((uint32_t *)ret)[-1] = raw;
+    return (void *)ret;
+}
+
+/**
+ * @brief Return a chunk allocated with snrt_l1alloc_banked
+ *
+ * @param ptr pointer returned by snrt_l1alloc_banked, may be 0
+ */
+void snrt_l1free_banked(void *ptr) {
+    if (!ptr) return;
+    snrt_l3free((void *)((uint32_t *)ptr)[-1]);
 }
 
 /**
  * @brief Init the allocator
- * @details
+ * @details The L1 memory is laid out as the block size table, the per-core
+ * arenas and the shared pool. Arenas are ordered by core index, so the
+ * arenas of one tile are contiguous. Each arena gets up to
+ * SNRT_L1_ARENA_LINES lines, but together they take at most half of the
+ * cluster memory. If that leaves less than a line per core, as on a 2 KiB
+ * TCDM shared by 16 cores, there are no arenas and all cores allocate from
+ * the shared pool. Every core initializes its own arena descriptor.
  *
  * @param snrt_team_root pointer to the team structure
  * @param l3off Number of bytes to skip on _edram before starting allocator
  */
 void snrt_alloc_init(struct snrt_team_root *team, uint32_t l3off) {
+    struct snrt_allocator *alloc = &team->allocator;
+    uint32_t ncores = team->cluster_core_num;
     // Allocator in L1 TCDM memory
-    team->allocator.l1.base =
-        ALIGN_UP((uint32_t)team->cluster_mem.start, MIN_CHUNK_SIZE);
-    team->allocator.l1.size =
-        (uint32_t)(team->cluster_mem.end - team->cluster_mem.start);
-    team->allocator.l1.next = team->allocator.l1.base;
-    // Allocator in L3 shared memory
-    extern uint32_t _edram;
-    team->allocator.l3.base =
-        ALIGN_UP((uint32_t)_edram + l3off, MIN_CHUNK_SIZE);
-    ;
-    team->allocator.l3.size = 0;
-    team->allocator.l3.next = team->allocator.l3.base;
+    uint32_t l1_start =
+        ALIGN_UP((uint32_t)team->cluster_mem.start, SNRT_L1_ALLOC_ALIGN);
+    uint32_t l1_end =
+        ALIGN_DOWN((uint32_t)team->cluster_mem.end, SNRT_L1_ALLOC_ALIGN);
+    uint32_t l1_lines = (l1_end - l1_start) / SNRT_L1_ALLOC_ALIGN;
+    alloc->l1_lines = (uint16_t *)l1_start;
+    alloc->l1_lines_base = l1_start;
+    alloc->l1_arena = l1_arenas;
+    uint32_t arena_start =
+        ALIGN_UP(l1_start + l1_lines * sizeof(uint16_t), SNRT_L1_ALLOC_ALIGN);
+    uint32_t arena_lines =
+        arena_start < l1_end
+            ? (l1_end - arena_start) / SNRT_L1_ALLOC_ALIGN / (2 * ncores)
+            : 0;
+    uint32_t arena_size =
+        snrt_min(arena_lines, SNRT_L1_ARENA_LINES) * SNRT_L1_ALLOC_ALIGN;
+
+    struct snrt_l1_arena *arena = &alloc->l1_arena[snrt_cluster_core_idx()];
+    arena->inst.base = arena_start + snrt_cluster_core_idx() * arena_size;
+    arena->inst.size = arena_size;
+    arena->inst.next = arena->inst.base;
+    for (uint32_t i = 0; i < SNRT_L1_ALLOC_NUM_BINS; i++) arena->free[i] = 0;
+    arena->large = 0;
+    arena->pool_run = 0;
+    arena->pool_top = 0;
+
+    alloc->l1.base = arena_start + ncores * arena_size;
+    alloc->l1.size = l1_end - alloc->l1.base;
+    alloc->l1.next = alloc->l1.base;
+    // Allocator in L3 shared memory, bounded by the next section in DRAM and
+    // the end of the global memory
+    extern uint32_t _edram, __l3_heap_end;
+    uint32_t l3_end = (uint32_t)&__l3_heap_end;
+    if (team->global_mem.end && team->global_mem.end < l3_end)
+        l3_end = (uint32_t)team->global_mem.end;
+    alloc->l3.base = ALIGN_UP((uint32_t)&_edram + l3off, MIN_CHUNK_SIZE);
+    alloc->l3.size = l3_end > alloc->l3.base ? l3_end - alloc->l3.base : 0;
+    alloc->l3.next = alloc->l3.base;
+    alloc->l3_free = 0;
+    alloc->l3_peak = alloc->l3.base;
+    alloc->l3_mutex = 0;
 }
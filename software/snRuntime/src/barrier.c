@@ -9,23 +9,41 @@ extern void _snrt_cluster_barrier();
 /// Synchronize cores in a cluster with a hardware barrier
 void snrt_cluster_hw_barrier() { _snrt_cluster_barrier(); }
 
-/// Synchronize cores in a cluster with a software barrier
+/// Barrier counter padded to its own cacheline
+struct snrt_barrier_node {
+    struct snrt_barrier barr;
+} __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES)));
+
+// Tile-level nodes of the combining tree, one cacheline per tile. Which bank
+// caches a node depends on the xbar offset, so the nodes only keep the tiles
+// from contending with each other, not the traffic on the tile.
+static struct snrt_barrier_node tile_barrier[SNRT_CLUSTER_MAX_CORES];
+// Cluster-level node, only touched by one representative per tile
+static struct snrt_barrier_node cluster_barrier;
+
+/**
+ * @brief Synchronize cores in a cluster with a software barrier
+ * @details Two-level combining tree: the cores of a tile sync on the tile's
+ * node, the last one to arrive syncs with the other tiles on the cluster node
+ * and then releases its tile. Only one core per tile crosses tiles.
+ */
 void snrt_cluster_sw_barrier() {
+    uint32_t tiles = snrt_cluster_tile_num();
+    uint32_t cores_per_tile = snrt_cluster_core_num() / tiles;
+    struct snrt_barrier *barr = &tile_barrier[snrt_cluster_tile_idx()].barr;
+
     // Remember previous iteration
-    volatile struct snrt_barrier *barrier_ptr =
-        &_snrt_team_current->root->cluster_barrier;
-    uint32_t prev_barrier_iteration = barrier_ptr->barrier_iteration;
-    uint32_t barrier =
-        __atomic_add_fetch(&barrier_ptr->barrier, 1, __ATOMIC_RELAXED);
+    uint32_t prev_it = barr->barrier_iteration;
+    uint32_t barrier = __atomic_add_fetch(&barr->barrier, 1, __ATOMIC_RELAXED);
 
-    // Increment the barrier counter
-    if (barrier == snrt_cluster_core_num()) {
-        barrier_ptr->barrier = 0;
-        __atomic_add_fetch(&barrier_ptr->barrier_iteration, 1,
-                           __ATOMIC_RELAXED);
+    if (barrier == cores_per_tile) {
+        // Last core of the tile represents it at cluster level
+        if (tiles > 1) snrt_barrier(&cluster_barrier.barr, tiles);
+        barr->barrier = 0;
+        __atomic_add_fetch(&barr->barrier_iteration, 1, __ATOMIC_RELAXED);
     } else {
-        // Some threads have not reached the barrier --> Let's wait
-        while (prev_barrier_iteration == barrier_ptr->barrier_iteration)
+        // Some cores of the tile have not reached the barrier --> Let's wait
+        while (prev_it == barr->barrier_iteration)
             ;
     }
 }
@@ -74,3 +92,129 @@ void snrt_barrier(struct snrt_barrier *barr, uint32_t n) {
             ;
     }
 }
+
+// Split-phase cluster barrier, the generation counter sits in its own
+// cacheline so that waiters do not slow down arriving cores
+static struct snrt_barrier_node split_count;
+static struct snrt_barrier_node split_generation;
+
+/**
+ * @brief Signal arrival at the split-phase cluster barrier
+ * @details Does not block. The core may do work that does not depend on the
+ * other cores and then call snrt_barrier_wait with the returned token. Every
+ * arrive must be followed by its wait before the core arrives again.
+ *
+ * @return token to pass to snrt_barrier_wait
+ */
+uint32_t snrt_barrier_arrive() {
+    // Cannot advance before this core arrived, so it is the current episode
+    uint32_t token = split_generation.barr.barrier_iteration;
+    uint32_t barrier =
+        __atomic_add_fetch(&split_count.barr.barrier, 1, __ATOMIC_RELAXED);
+
+    if (barrier == snrt_cluster_core_num()) {
+        split_count.barr.barrier = 0;
+        __atomic_add_fetch(&split_generation.barr.barrier_iteration, 1,
+                           __ATOMIC_RELAXED);
+    }
+    return token;
+}
+
+/**
+ * @brief Wait until all cores arrived at the split-phase cluster barrier
+ *
+ * @param token value returned by the matching snrt_barrier_arrive
+ */
+void snrt_barrier_wait(uint32_t token) {
+    while (split_generation.barr.barrier_iteration == token)
+        ;
+}
+
+/// Sense-reversing barrier releasing the cores in `mask`
+static inline void sense_barrier(struct snrt_sense_barrier *barr, uint32_t n,
+                                 uint32_t mask) {
+    volatile uint32_t *flag = &barr->flag[snrt_cluster_core_idx()].sense;
+    uint32_t sense = !*flag;
+
+    if (__atomic_add_fetch(&barr->count, 1, __ATOMIC_RELAXED) == n) {
+        barr->count = 0;
+        for (; mask; mask &= mask - 1)
+            barr->flag[__builtin_ctz(mask)].sense = sense;
+    } else {
+        // Some threads have not reached the barrier --> Let's wait
+        while (*flag != sense)
+            ;
+    }
+}
+
+/**
+ * @brief Sense-reversing barrier
+ * @details Every core polls the flag in its own cacheline instead of a
+ * shared iteration word. The last core to arrive resets the counter and
+ * flips the flags of all cores of the cluster, so the flags always hold the
+ * sense of the last completed episode.
+ *
+ * All episodes of a barrier object must have the same participants. A core
+ * joining in later could bump the counter before the previous episode reset
+ * it, or read its flag before the flip of the previous episode reached it,
+ * and be released early. The participants may only change once all cores
+ * have left the previous episode, e.g. after a join as between two OpenMP
+ * parallel regions.
+ *
+ * @param barr pointer to a zero-initialized barrier
+ * @param n number of harts that have to enter before released
+ */
+void snrt_sense_barrier(struct snrt_sense_barrier *barr, uint32_t n) {
+    sense_barrier(barr, n, (1 << snrt_cluster_core_num()) - 1);
+}
+
+//================================================================================
+// Sub-teams
+//================================================================================
+
+/**
+ * @brief Init a sub-team from a core mask
+ * @details The sub-team must be zero-initialized, e.g. static. Every member
+ * may call the init with the same arguments, it does not touch the barrier.
+ *
+ * @param team sub-team to init
+ * @param mask bit `i` selects cluster core `i`
+ */
+void snrt_subteam_init_mask(struct snrt_subteam *team, uint32_t mask) {
+    team->mask = mask & ((1 << snrt_cluster_core_num()) - 1);
+    team->num = __builtin_popcount(team->mask);
+}
+
+/**
+ * @brief Init a sub-team from a range of consecutive cores
+ *
+ * @param team sub-team to init
+ * @param first cluster core index of the first member
+ * @param num number of members
+ */
+void snrt_subteam_init_range(struct snrt_subteam *team, uint32_t first,
+                             uint32_t num) {
+    uint32_t mask = num >= 32 ? ~0u : (1u << num) - 1;
+    snrt_subteam_init_mask(team, first >= 32 ? 0 : mask << first);
+}
+
+/// Check whether the calling core is a member of the sub-team
+int snrt_subteam_is_member(const struct snrt_subteam *team) {
+    return (team->mask >> snrt_cluster_core_idx()) & 1;
+}
+
+/**
+ * @brief Synchronize the members of a sub-team
+ * @details Only the members take part, all other cores keep running. A
+ * sub-team of the whole cluster uses the hardware barrier. The hardware
+ * cannot sync a subset of the tiles, so any other sub-team uses the
+ * sense-reversing barrier and releases only its members.
+ *
+ * @param team sub-team of the calling core
+ */
+void snrt_subteam_barrier(struct snrt_subteam *team) {
+    if (team->num == snrt_cluster_core_num())
+        snrt_cluster_hw_barrier();
+    else
+        sense_barrier(&team->barrier, team->num, team->mask);
+}
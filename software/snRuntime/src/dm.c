@@ -22,15 +22,21 @@
 
 /**
  * @brief Number of outstanding transactions to buffer. Each requires
- * sizeof(dm_task_t) bytes
+ * sizeof(dm_task_t) bytes. Must be a power of two
  *
  */
+#ifndef DM_TASK_QUEUE_SIZE
 #define DM_TASK_QUEUE_SIZE 4
+#endif
+_Static_assert((DM_TASK_QUEUE_SIZE & (DM_TASK_QUEUE_SIZE - 1)) == 0,
+               "DM_TASK_QUEUE_SIZE must be a power of two");
 
 //================================================================================
 // Macros
 //================================================================================
 
+#define DM_TASK_QUEUE_MASK (DM_TASK_QUEUE_SIZE - 1)
+
 #define _dm_mtx_lock() snrt_mutex_lock(&dm_p->mutex)
 #define _dm_mtx_release() snrt_mutex_release(&dm_p->mutex)
 
@@ -45,6 +51,16 @@
 //================================================================================
 // Types
 //================================================================================
+// Kinds of transfers a task describes
+typedef enum en_task {
+    DM_TASK_1D = 0,
+    DM_TASK_2D = 1,
+    // 2D transfers repeated along a third dimension
+    DM_TASK_3D = 2,
+    // list of 1D transfers at `src` with `size` entries
+    DM_TASK_SG = 3,
+} en_task_t;
+
 typedef struct {
     uint64_t src;
     uint64_t dst;
@@ -53,7 +69,16 @@ typedef struct {
     uint32_t dstrd;
     uint32_t nreps;
     uint32_t cfg;
-    uint32_t twod;
+    en_task_t type;
+    // outer dimension of 3D tasks
+    uint32_t sstrd2;
+    uint32_t dstrd2;
+    uint32_t nreps2;
+    // DMA transfer ID, set once the DM core issued the task
+    uint32_t txid;
+    // Ticket the slot is ready for: `ticket` to be claimed by the producer of
+    // that ticket, `ticket + 1` once the task is published
+    volatile uint32_t seq;
 } dm_task_t;
 
 // used for ultra-fine grained communication
@@ -68,16 +93,21 @@ typedef enum en_stat {
     STAT_READY = 3,
 } en_stat_t;
 
+// The queue is a ring of tickets: producers claim the next ticket at `head`
+// with a CAS, the DM core issues tickets at `issue` and retires them at
+// `done` once the DMA has completed them, which frees their slot.
 typedef struct {
     dm_task_t queue[DM_TASK_QUEUE_SIZE];
-    uint32_t queue_back;
-    uint32_t queue_front;
-    volatile uint32_t queue_fill;
+    volatile uint32_t head;
+    uint32_t issue;
+    volatile uint32_t done;
     volatile uint32_t mutex;
     volatile en_stat_t stat_q;
     volatile uint32_t stat_p;
     volatile uint32_t stat_pvalid;
     volatile uint32_t dm_wfi;
+    // cluster cores sleeping in DM_WAIT_WFI mode, woken on every retirement
+    volatile uint32_t waiters;
 } dm_t;
 
 //================================================================================
@@ -101,11 +131,20 @@ static volatile dm_t *volatile dm_p_global;
  */
 __thread uint32_t cluster_dm_core_idx;
 
+/**
+ * @brief How this hart waits for the data mover, see dm_set_wait_mode
+ *
+ */
+__thread dm_wait_mode_t dm_wait_mode;
+
 //================================================================================
 // Declarations
 //================================================================================
+static uint32_t dm_issue(volatile dm_task_t *t);
 static void wfi_dm(uint32_t cluster_core_idx);
 static void wake_dm(void);
+static void wake_waiters(void);
+static void dm_sleep_until(int (*cond)(uint32_t), uint32_t arg);
 
 //================================================================================
 // Debug
@@ -140,6 +179,8 @@ void dm_init(void) {
 #endif
         dm_p = (dm_t *)snrt_l1alloc(sizeof(dm_t));
         snrt_memset((void *)dm_p, 0, sizeof(dm_t));
+        for (uint32_t i = 0; i < DM_TASK_QUEUE_SIZE; i++)
+            dm_p->queue[i].seq = i;
         dm_p_global = dm_p;
     } else {
         while (!dm_p_global)
@@ -157,25 +198,28 @@ void dm_main(void) {
 
     while (!do_exit) {
         /// New transaction to issue?
-        if (dm_p->queue_fill) {
-            // wait until DMA is ready
-            while (__builtin_sdma_stat(DM_STATUS_WOULD_BLOCK))
-                ;
-
-            t = &dm_p->queue[dm_p->queue_back];
-
-            if (t->twod) {
-                DM_PRINTF(10, "start twod\n");
-                __builtin_sdma_start_twod(t->src, t->dst, t->size, t->sstrd,
-                                          t->dstrd, t->nreps, t->cfg);
-            } else {
-                DM_PRINTF(10, "start oned\n");
-                __builtin_sdma_start_oned(t->src, t->dst, t->size, t->cfg);
-            }
+        t = &dm_p->queue[dm_p->issue & DM_TASK_QUEUE_MASK];
+        if (t->seq == dm_p->issue + 1 &&
+            !__builtin_sdma_stat(DM_STATUS_WOULD_BLOCK)) {
+            t->txid = dm_issue(t);
+            dm_p->issue++;
+        }
 
-            // bump
-            dm_p->queue_back = (dm_p->queue_back + 1) % DM_TASK_QUEUE_SIZE;
-            __atomic_add_fetch(&dm_p->queue_fill, -1, __ATOMIC_RELAXED);
+        /// Retire completed transactions, the DMA completes them in order
+        if (dm_p->done != dm_p->issue) {
+            uint32_t completed = __builtin_sdma_stat(DM_STATUS_COMPLETE_ID);
+            uint32_t done = dm_p->done;
+            while (done != dm_p->issue) {
+                t = &dm_p->queue[done & DM_TASK_QUEUE_MASK];
+                if ((int32_t)(completed - t->txid) <= 0) break;
+                // free the slot for the ticket one lap ahead
+                t->seq = done + DM_TASK_QUEUE_SIZE;
+                done++;
+            }
+            if (done != dm_p->done) {
+                __atomic_store_n(&dm_p->done, done, __ATOMIC_RELEASE);
+                wake_waiters();
+            }
         }
 
         /// any STAT request pending?
@@ -188,6 +232,7 @@ void dm_main(void) {
                         DM_PRINTF(50, "idle\n");
                         dm_p->stat_pvalid = 1;
                         dm_p->stat_q = 0;
+                        wake_waiters();
                     }
                     break;
                 case STAT_EXIT:
@@ -197,12 +242,15 @@ void dm_main(void) {
                     DM_PRINTF(50, "ready\n");
                     dm_p->stat_pvalid = 1;
                     dm_p->stat_q = 0;
+                    wake_waiters();
                     break;
             }
         }
 
-        // sleep if queue is empty and no stats pending
-        if (!dm_p->queue_fill && !dm_p->stat_q) {
+        // sleep if nothing is queued or in flight and no stats pending
+        t = &dm_p->queue[dm_p->issue & DM_TASK_QUEUE_MASK];
+        if (t->seq != dm_p->issue + 1 && dm_p->done == dm_p->issue &&
+            !dm_p->stat_q) {
             wfi_dm(cluster_core_idx);
         }
     }
@@ -215,79 +263,162 @@ void dm_main(void) {
     return;
 }
 
-void dm_memcpy_async(void *dest, const void *src, size_t n) {
-    uint32_t s;
+/**
+ * @brief Claim the slot of the next ticket, blocks only if the ring is full
+ * @details Lock-free: producers race for `head` with a CAS on the ticket
+ * whose slot the DM core has freed.
+ */
+static volatile dm_task_t *dm_task_claim(dm_token_t *ticket) {
+    uint32_t pos = __atomic_load_n(&dm_p->head, __ATOMIC_RELAXED);
+    for (;;) {
+        volatile dm_task_t *t = &dm_p->queue[pos & DM_TASK_QUEUE_MASK];
+        int32_t diff = (int32_t)(t->seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&dm_p->head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                *ticket = pos;
+                return t;
+            }
+        } else {
+            // The ring is full (diff < 0) and the DM core has to retire a
+            // transfer first, or another producer took the ticket
+            pos = __atomic_load_n(&dm_p->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/// Hand a filled slot to the DM core
+static inline void dm_task_publish(volatile dm_task_t *t, dm_token_t ticket) {
+    __atomic_store_n(&t->seq, ticket + 1, __ATOMIC_RELEASE);
+}
+
+dm_token_t dm_memcpy_async(void *dest, const void *src, size_t n) {
+    dm_token_t ticket;
     volatile dm_task_t *t;
 
     DM_PRINTF(10, "dm_memcpy_async %#x -> %#x size %d\n", src, dest,
               (uint32_t)n);
 
-    // poll queue size
-    do {
-        s = __atomic_load_n(&dm_p->queue_fill, __ATOMIC_RELAXED);
-    } while (s >= DM_TASK_QUEUE_SIZE);
-    _dm_mtx_lock();
-
-    // insert
-    t = &dm_p->queue[dm_p->queue_front];
+    t = dm_task_claim(&ticket);
     t->src = (uint64_t)src;
     t->dst = (uint64_t)dest;
     t->size = (uint32_t)n;
-    t->twod = 0;
+    t->type = DM_TASK_1D;
     t->cfg = 0;
+    dm_task_publish(t, ticket);
 
-    // bump
-    __atomic_add_fetch(&dm_p->queue_fill, 1, __ATOMIC_RELAXED);
-    dm_p->queue_front = (dm_p->queue_front + 1) % DM_TASK_QUEUE_SIZE;
-
-    _dm_mtx_release();
+    return ticket;
 }
 
-void dm_memcpy2d_async(uint64_t src, uint64_t dst, uint32_t size,
-                       uint32_t sstrd, uint32_t dstrd, uint32_t nreps,
-                       uint32_t cfg) {
-    uint32_t s;
+dm_token_t dm_memcpy2d_async(uint64_t src, uint64_t dst, uint32_t size,
+                             uint32_t sstrd, uint32_t dstrd, uint32_t nreps,
+                             uint32_t cfg) {
+    dm_token_t ticket;
     volatile dm_task_t *t;
 
     DM_PRINTF(10, "dm_memcpy2d_async %#x -> %#x size %d\n", src, dst,
               (uint32_t)size);
 
-    // poll queue size
-    do {
-        s = __atomic_load_n(&dm_p->queue_fill, __ATOMIC_RELAXED);
-    } while (s >= DM_TASK_QUEUE_SIZE);
-    _dm_mtx_lock();
+    t = dm_task_claim(&ticket);
+    t->src = src;
+    t->dst = dst;
+    t->size = size;
+    t->sstrd = sstrd;
+    t->dstrd = dstrd;
+    t->nreps = nreps;
+    t->type = DM_TASK_2D;
+    t->cfg = cfg;
+    dm_task_publish(t, ticket);
+
+    return ticket;
+}
 
-    // insert
-    t = &dm_p->queue[dm_p->queue_front];
+dm_token_t dm_memcpy3d_async(uint64_t src, uint64_t dst, uint32_t size,
+                             uint32_t sstrd, uint32_t dstrd, uint32_t nreps,
+                             uint32_t sstrd2, uint32_t dstrd2, uint32_t nreps2,
+                             uint32_t cfg) {
+    dm_token_t ticket;
+    volatile dm_task_t *t;
+
+    DM_PRINTF(10, "dm_memcpy3d_async %#x -> %#x size %d\n", src, dst,
+              (uint32_t)size);
+
+    t = dm_task_claim(&ticket);
     t->src = src;
     t->dst = dst;
     t->size = size;
     t->sstrd = sstrd;
     t->dstrd = dstrd;
     t->nreps = nreps;
-    t->twod = 1;
+    t->sstrd2 = sstrd2;
+    t->dstrd2 = dstrd2;
+    t->nreps2 = nreps2;
+    t->type = DM_TASK_3D;
     t->cfg = cfg;
+    dm_task_publish(t, ticket);
 
-    // bump
-    __atomic_add_fetch(&dm_p->queue_fill, 1, __ATOMIC_RELAXED);
-    dm_p->queue_front = (dm_p->queue_front + 1) % DM_TASK_QUEUE_SIZE;
+    return ticket;
+}
 
-    _dm_mtx_release();
+dm_token_t dm_memcpy_sg_async(const struct snrt_dma_sg_entry *list,
+                              uint32_t n) {
+    dm_token_t ticket;
+    volatile dm_task_t *t;
+
+    DM_PRINTF(10, "dm_memcpy_sg_async %#x entries %d\n", list, n);
+
+    t = dm_task_claim(&ticket);
+    t->src = (uint64_t)(uint32_t)list;
+    t->size = n;
+    t->type = DM_TASK_SG;
+    t->cfg = 0;
+    dm_task_publish(t, ticket);
+
+    return ticket;
+}
+
+int dm_done(dm_token_t token) {
+    return (int32_t)(__atomic_load_n(&dm_p->done, __ATOMIC_ACQUIRE) - token) > 0;
+}
+
+void dm_set_wait_mode(dm_wait_mode_t mode) { dm_wait_mode = mode; }
+
+void dm_wait_token(dm_token_t token) {
+    if (dm_done(token)) return;
+    // signal data mover
+    wake_dm();
+    if (dm_wait_mode == DM_WAIT_WFI) {
+        dm_sleep_until(dm_done, token);
+    } else {
+        while (!dm_done(token))
+            ;
+    }
 }
 
 void dm_start(void) { wake_dm(); }
 
+/// Wait conditions for dm_sleep_until
+static int dm_all_done(uint32_t arg) {
+    (void)arg;
+    return dm_done(__atomic_load_n(&dm_p->head, __ATOMIC_RELAXED) - 1);
+}
+static int dm_stat_valid(uint32_t arg) {
+    (void)arg;
+    return dm_p->stat_pvalid;
+}
+
 void dm_wait(void) {
     uint32_t s;
 
     // signal data mover
     wake_dm();
 
-    // first, wait for the dm queue to be empty and no request be pending
+    // first, wait for all queued transfers to retire and no request be pending
+    if (dm_wait_mode == DM_WAIT_WFI) dm_sleep_until(dm_all_done, 0);
     do {
-        s = __atomic_load_n(&dm_p->queue_fill, __ATOMIC_RELAXED);
-    } while (s != 0);
+        s = __atomic_load_n(&dm_p->head, __ATOMIC_RELAXED);
+    } while (!dm_done(s - 1));
     while (dm_p->stat_q)
         ;
 
@@ -300,6 +431,7 @@ void dm_wait(void) {
     // signal data mover
     wake_dm();
     // whenever stat_pvalid is non-zero, the DMA has completed all transfers
+    if (dm_wait_mode == DM_WAIT_WFI) dm_sleep_until(dm_stat_valid, 0);
     while (!dm_p->stat_pvalid)
         ;
     _dm_mtx_release();
@@ -325,6 +457,91 @@ void dm_wait_ready(void) {
 // private
 //================================================================================
 
+/**
+ * @brief Start all DMA transfers of a task
+ * @return ID of the last transfer, the task is complete with it. A task that
+ * moves nothing gets an ID that is complete already, so it retires right
+ * after the tasks before it.
+ */
+static uint32_t dm_issue(volatile dm_task_t *t) {
+    uint32_t txid = __builtin_sdma_stat(DM_STATUS_COMPLETE_ID) - 1;
+
+    switch (t->type) {
+        case DM_TASK_1D:
+            DM_PRINTF(10, "start oned\n");
+            txid = __builtin_sdma_start_oned(t->src, t->dst, t->size, t->cfg);
+            break;
+        case DM_TASK_2D:
+            DM_PRINTF(10, "start twod\n");
+            txid = __builtin_sdma_start_twod(t->src, t->dst, t->size, t->sstrd,
+                                             t->dstrd, t->nreps, t->cfg);
+            break;
+        case DM_TASK_3D:
+            DM_PRINTF(10, "start threed\n");
+            for (uint32_t i = 0; i < t->nreps2; i++) {
+                while (__builtin_sdma_stat(DM_STATUS_WOULD_BLOCK))
+                    ;
+                txid = __builtin_sdma_start_twod(
+                    t->src + i * t->sstrd2, t->dst + i * t->dstrd2, t->size,
+                    t->sstrd, t->dstrd, t->nreps, t->cfg);
+            }
+            break;
+        case DM_TASK_SG:
+            DM_PRINTF(10, "start sg\n");
+            for (uint32_t i = 0; i < t->size; i++) {
+                const struct snrt_dma_sg_entry *e =
+                    (const struct snrt_dma_sg_entry *)(uint32_t)t->src + i;
+                while (__builtin_sdma_stat(DM_STATUS_WOULD_BLOCK))
+                    ;
+                txid = __builtin_sdma_start_oned((uint64_t)(uint32_t)e->src,
+                                                 (uint64_t)(uint32_t)e->dst,
+                                                 e->size, t->cfg);
+            }
+            break;
+    }
+    return txid;
+}
+
+/**
+ * @brief Sleep in wfi until `cond(arg)` holds
+ * @details The hart announces itself in `waiters` before re-checking the
+ * condition, so either the re-check succeeds or the DM core sees the flag
+ * once it made progress and sends a cluster-local interrupt. The interrupt is
+ * latched, a wakeup that arrives before the wfi turns it into a NOP.
+ *
+ * The cluster-local interrupt of a hart is shared with the OpenMP event unit.
+ * The pending bit is only cleared once the DM core took the hart's flag out of
+ * `waiters`, i.e. the wakeup is known to be its own. Any other wakeup stays
+ * pending for its owner, which turns the wfi into a re-check of `cond` until
+ * the DM core answers. The interrupt enable is restored on return since
+ * workers keep it set while they run the event loop.
+ */
+static void dm_sleep_until(int (*cond)(uint32_t), uint32_t arg) {
+    uint32_t mask = 1 << snrt_cluster_core_idx();
+    uint32_t irq_en = read_csr(mie) & (1 << IRQ_M_CLUSTER);
+
+    snrt_interrupt_enable(IRQ_M_CLUSTER);
+    while (1) {
+        __atomic_fetch_or(&dm_p->waiters, mask, __ATOMIC_SEQ_CST);
+        if (cond(arg)) break;
+        snrt_wfi();
+        if (!(__atomic_load_n(&dm_p->waiters, __ATOMIC_ACQUIRE) & mask))
+            snrt_int_cluster_clr(mask);
+    }
+    __atomic_fetch_and(&dm_p->waiters, ~mask, __ATOMIC_RELAXED);
+    if (!irq_en) snrt_interrupt_disable(IRQ_M_CLUSTER);
+}
+
+/// Wake all harts sleeping in dm_sleep_until, they re-check their condition
+static void wake_waiters(void) {
+    // order the progress before the look at `waiters`, pairs with the
+    // announcement in dm_sleep_until
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!dm_p->waiters) return;
+    uint32_t mask = __atomic_exchange_n(&dm_p->waiters, 0, __ATOMIC_RELAXED);
+    if (mask) snrt_int_cluster_set(mask);
+}
+
 #ifdef DM_USE_GLOBAL_CLINT
 static void wfi_dm(uint32_t cluster_core_idx) {
     (void)cluster_core_idx;
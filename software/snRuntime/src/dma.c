@@ -123,6 +123,65 @@ snrt_dma_txid_t snrt_dma_start_2d(void *dst, const void *src, size_t size,
                                      src_stride, repeat);
 }
 
+/**
+ * @brief ID that snrt_dma_wait considers complete right away, returned for
+ * transfers that move nothing
+ */
+static snrt_dma_txid_t dma_txid_done(void) {
+    // dmstati t0, 0  # 0=status.completed_id
+    register uint32_t reg_completed asm("t0");
+    asm volatile(
+        ".word (0b0000100 << 25) | \
+               (  0b00000 << 20) | \
+               (    0b000 << 12) | \
+               (      (5) <<  7) | \
+               (0b0101011 <<  0)   \n"
+        : "=r"(reg_completed));
+    return reg_completed - 1;
+}
+
+/**
+ * @brief Initiate an asynchronous 3D DMA transfer
+ * @details The DMA has no third dimension, the transfer is issued as
+ * `repeat_3d` 2D transfers that are `dst_stride_3d` and `src_stride_3d`
+ * bytes apart.
+ *
+ * @return ID of the last 2D transfer, the 3D transfer is complete with it.
+ * With `repeat_3d` zero nothing is issued and the ID is complete already.
+ */
+snrt_dma_txid_t snrt_dma_start_3d(void *dst, const void *src, size_t size,
+                                  size_t dst_stride, size_t src_stride,
+                                  size_t repeat, size_t dst_stride_3d,
+                                  size_t src_stride_3d, size_t repeat_3d) {
+    if (!repeat_3d) return dma_txid_done();
+    snrt_dma_txid_t txid = 0;
+    for (size_t i = 0; i < repeat_3d; i++) {
+        txid = snrt_dma_start_2d((char *)dst + i * dst_stride_3d,
+                                 (const char *)src + i * src_stride_3d, size,
+                                 dst_stride, src_stride, repeat);
+    }
+    return txid;
+}
+
+/**
+ * @brief Initiate the DMA transfers of a scatter-gather list
+ * @details Every entry is a 1D transfer. They are issued back to back, so
+ * waiting for the returned ID waits for the whole list.
+ *
+ * @param list scatter-gather entries
+ * @param n number of entries
+ * @return ID of the last transfer. With `n` zero nothing is issued and the
+ * ID is complete already.
+ */
+snrt_dma_txid_t snrt_dma_start_sg(const struct snrt_dma_sg_entry *list,
+                                  uint32_t n) {
+    if (!n) return dma_txid_done();
+    snrt_dma_txid_t txid = 0;
+    for (uint32_t i = 0; i < n; i++)
+        txid = snrt_dma_start_1d(list[i].dst, list[i].src, list[i].size);
+    return txid;
+}
+
 /// Block until a transfer finishes.
 void snrt_dma_wait(snrt_dma_txid_t tid) {
     // dmstati t0, 0  # 2=status.completed_id
@@ -151,3 +210,49 @@ void snrt_dma_wait_all() {
         "bne t0, zero, 1b \n" ::
             : "t0");
 }
+
+/**
+ * @brief Stream tiles through a compute function with multi-buffering
+ * @details With `n` buffers, tiles `i + 1` to `i + n - 1` are fetched while
+ * tile `i` is computed. A buffer is refilled only once its previous tile has
+ * been computed and, if there is a `dst`, written back. Must run on a core
+ * with the DMA extension.
+ *
+ * @param p pipeline description, with 2 to SNRT_DMA_PIPELINE_MAX_BUFS buffers
+ * @return 0 once all tiles are done, -1 without running anything if the
+ * number of buffers is out of range
+ */
+int snrt_dma_pipeline_run(const struct snrt_dma_pipeline *p) {
+    snrt_dma_txid_t load[SNRT_DMA_PIPELINE_MAX_BUFS];
+    snrt_dma_txid_t store[SNRT_DMA_PIPELINE_MAX_BUFS];
+    const uint32_t nbufs = p->num_bufs;
+    uint32_t stored = 0;
+
+    if (nbufs < 2 || nbufs > SNRT_DMA_PIPELINE_MAX_BUFS) return -1;
+
+    for (uint32_t i = 0; i < p->num_tiles + nbufs - 1; i++) {
+        // Fetch tile i into the buffer that tile i - nbufs has left
+        if (i < p->num_tiles) {
+            uint32_t b = i % nbufs;
+            if (stored & (1 << b)) snrt_dma_wait(store[b]);
+            load[b] = snrt_dma_start_2d(
+                p->buf[b], (const char *)p->src + i * p->src_tile_stride,
+                p->size, p->size, p->src_stride, p->repeat);
+        }
+        // Compute the oldest tile in flight and write it back
+        if (i >= nbufs - 1) {
+            uint32_t tile = i - (nbufs - 1);
+            uint32_t b = tile % nbufs;
+            snrt_dma_wait(load[b]);
+            p->compute(p->buf[b], tile, p->arg);
+            if (p->dst) {
+                store[b] = snrt_dma_start_2d(
+                    (char *)p->dst + tile * p->dst_tile_stride, p->buf[b],
+                    p->size, p->dst_stride, p->size, p->repeat);
+                stored |= 1 << b;
+            }
+        }
+    }
+    if (p->dst) snrt_dma_wait_all();
+    return 0;
+}
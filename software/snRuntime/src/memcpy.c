@@ -4,20 +4,223 @@
 
 #include <string.h>
 
+#include "dm.h"
+#include "l1cache.h"
 #include "snrt.h"
 
-// TODO: Implement using cluster DMA for a faster `memcpy`.
 void *snrt_memcpy(void *dst, const void *src, size_t n) {
     return memcpy(dst, src, n);
 }
 
-void* memcpy(void *dest, const void *src, size_t n) {
-  const char *csrc = (const char *)src;
-  char *cdest = (char *)dest;
+//================================================================================
+// Vector copies
+//================================================================================
 
-  // Copy contents of src[] to dest[]
-  for (size_t i = 0; i < n; ++i)
-    cdest[i] = csrc[i];
+/// Copy `n` elements of `ew` bits with register groups of `lmul` registers
+#define VMEMCPY_LOOP(ew, lmul, d, s, n)                                 \
+    for (size_t vl; n; n -= vl, d += vl, s += vl) {                     \
+        asm volatile("vsetvli %0, %1, e" #ew ", m" #lmul ", ta, ma"     \
+                     : "=r"(vl)                                         \
+                     : "r"(n));                                         \
+        asm volatile("vle" #ew ".v v0, (%0)" ::"r"(s) : "memory");      \
+        asm volatile("vse" #ew ".v v0, (%0)" ::"r"(d) : "memory");      \
+    }
 
-  return dest;
+static void vmemcpy_e32(uint32_t *d, const uint32_t *s, size_t n,
+                        uint32_t lmul) {
+    switch (lmul) {
+        case 1:
+            VMEMCPY_LOOP(32, 1, d, s, n);
+            break;
+        case 2:
+            VMEMCPY_LOOP(32, 2, d, s, n);
+            break;
+        case 4:
+            VMEMCPY_LOOP(32, 4, d, s, n);
+            break;
+        default:
+            VMEMCPY_LOOP(32, 8, d, s, n);
+            break;
+    }
+}
+
+static void vmemcpy_e8(uint8_t *d, const uint8_t *s, size_t n,
+                       uint32_t lmul) {
+    switch (lmul) {
+        case 1:
+            VMEMCPY_LOOP(8, 1, d, s, n);
+            break;
+        case 2:
+            VMEMCPY_LOOP(8, 2, d, s, n);
+            break;
+        case 4:
+            VMEMCPY_LOOP(8, 4, d, s, n);
+            break;
+        default:
+            VMEMCPY_LOOP(8, 8, d, s, n);
+            break;
+    }
+}
+
+/// Smallest register grouping that moves `n` bytes in one go, at most m8
+static inline uint32_t vmemcpy_lmul(size_t n) {
+    uint32_t vlenb;
+    asm volatile("csrr %0, vlenb" : "=r"(vlenb));
+    uint32_t lmul = 1;
+    while (lmul < 8 && lmul * vlenb < n) lmul <<= 1;
+    return lmul;
+}
+
+/**
+ * @brief Copy `n` bytes through the vector unit, at any alignment
+ * @details If source and destination are equally aligned, the bytes up to
+ * the first common word boundary are copied by the core, the words in
+ * between with 32-bit elements and the byte tail with 8-bit elements.
+ * Otherwise the whole copy uses 8-bit elements, which the VLSU accepts at
+ * any address. The register grouping is the smallest one that holds the
+ * copy in a single vector instruction, at most m8, so short copies
+ * occupy few registers and long ones issue few instructions.
+ *
+ * @return dst
+ */
+void *snrt_vmemcpy(void *dst, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    uint32_t lmul = vmemcpy_lmul(n);
+
+    if (!(((uint32_t)d ^ (uint32_t)s) & 3)) {
+        for (; n && ((uint32_t)d & 3); n--) *d++ = *s++;
+        size_t words = n / 4;
+        vmemcpy_e32((uint32_t *)d, (const uint32_t *)s, words, lmul);
+        d += words * 4;
+        s += words * 4;
+        n -= words * 4;
+    }
+    vmemcpy_e8(d, s, n, lmul);
+    return dst;
+}
+
+//================================================================================
+// DMA copies
+//================================================================================
+
+/// Whether the L1 data cache may hold lines of `ptr`, i.e. it is neither in
+/// the cluster memory nor uncached
+static int l1d_cacheable(const void *ptr) {
+    snrt_slice_t l1 = snrt_cluster_memory();
+    uint32_t addr = (uint32_t)ptr;
+    return !snrt_is_uncached(ptr) && (addr < l1.start || addr >= l1.end);
+}
+
+/**
+ * @brief Make the L1 data cache safe for a DMA copy from `src` to `dst`
+ * @details The DMA does not snoop the L1D. Flushing it writes dirty lines of
+ * `src` back before the DMA reads them, and drops the lines of `dst` so none
+ * of them is written back over the copy later. Pair with dma_copy_end.
+ */
+static void dma_copy_begin(void *dst, const void *src) {
+    if (!l1d_cacheable(dst) && !l1d_cacheable(src)) return;
+    l1d_flush();
+    l1d_wait();
+}
+
+/// Drop the lines of `dst` that were cached while the DMA wrote it
+static void dma_copy_end(void *dst) {
+    if (!l1d_cacheable(dst)) return;
+    l1d_flush();
+    l1d_wait();
+}
+
+/**
+ * @brief Copy `n` bytes, picking the engine by size
+ * @details Copies below SNRT_MEMCPY_VEC_MIN bytes are done by the core, a
+ * word at a time if source and destination are equally aligned. Bigger ones
+ * stream through the vector unit with snrt_vmemcpy. From
+ * SNRT_MEMCPY_DMA_MIN bytes on, a core with the DMA extension hands the copy
+ * to the DMA and waits for it, flushing the L1 data cache around it.
+ *
+ * All paths are spelled out in here: the compiler does not turn the loops of
+ * a function named memcpy back into calls to memcpy.
+ */
+void *memcpy(void *dest, const void *src, size_t n) {
+    char *cdest = (char *)dest;
+    const char *csrc = (const char *)src;
+    const uint32_t aligned = !(((uint32_t)cdest ^ (uint32_t)csrc) & 3);
+
+#if SNRT_MEMCPY_DMA_MIN > 0
+    if (n >= SNRT_MEMCPY_DMA_MIN && snrt_is_dm_core()) {
+        dma_copy_begin(dest, src);
+        snrt_dma_wait(snrt_dma_start_1d(dest, src, n));
+        dma_copy_end(dest);
+        return dest;
+    }
+#endif
+
+    if (n >= SNRT_MEMCPY_VEC_MIN) {
+        snrt_vmemcpy(cdest, csrc, n);
+        return dest;
+    } else if (aligned) {
+        for (; n && ((uint32_t)cdest & 3); n--) *cdest++ = *csrc++;
+        for (; n >= 4; n -= 4, cdest += 4, csrc += 4)
+            *(uint32_t *)cdest = *(const uint32_t *)csrc;
+    }
+
+    // Remaining bytes
+    for (size_t i = 0; i < n; ++i) cdest[i] = csrc[i];
+
+    return dest;
+}
+
+int snrt_is_uncached(const void *ptr) {
+    extern uint32_t __uncached_start, __uncached_end;
+    return (uint32_t)ptr >= (uint32_t)&__uncached_start &&
+           (uint32_t)ptr < (uint32_t)&__uncached_end;
+}
+
+/**
+ * @brief Copy `n` bytes of one-shot data without filling the L1 data cache
+ * @details The caller picks the route per call:
+ * - SNRT_STREAM_CACHED copies like memcpy.
+ * - SNRT_STREAM_UNCACHED streams through the vector unit. Accesses to
+ *   UNCACHED_REGION bypass the L1, so with the destination (write-back) or
+ *   the source (input payloads) declared SNRT_UNCACHED, only the other side
+ *   touches the cache. Copies that involve no uncached buffer fall back to
+ *   SNRT_STREAM_CACHED.
+ * - SNRT_STREAM_DMA moves the data with the DMA, which does not go through
+ *   the L1 at all. A core with the DMA extension issues the transfer itself,
+ *   any other core queues it to the DM core, which must be in dm_main. The
+ *   queue needs the LLVM toolchain, with others the copy falls back to
+ *   SNRT_STREAM_CACHED on cores without the DMA extension. Only
+ *   clusters with a DMA support this mode. The DMA does not snoop the L1,
+ *   so the L1 data cache is flushed around the transfer if a buffer is
+ *   cacheable, see dma_copy_begin.
+ *
+ * @return dst
+ */
+void *snrt_memcpy_stream(void *dst, const void *src, size_t n,
+                         enum snrt_stream_mode mode) {
+    switch (mode) {
+        case SNRT_STREAM_UNCACHED:
+            if (!snrt_is_uncached(dst) && !snrt_is_uncached(src)) break;
+            return snrt_vmemcpy(dst, src, n);
+        case SNRT_STREAM_DMA:
+            if (snrt_is_dm_core()) {
+                dma_copy_begin(dst, src);
+                snrt_dma_wait(snrt_dma_start_1d(dst, src, n));
+                dma_copy_end(dst);
+                return dst;
+            }
+#ifdef __clang__
+            // The DM queue in dm.c is only built with the LLVM toolchain
+            dma_copy_begin(dst, src);
+            dm_wait_token(dm_memcpy_async(dst, src, n));
+            dma_copy_end(dst);
+            return dst;
+#else
+            break;
+#endif
+        default:
+            break;
+    }
+    return memcpy(dst, src, n);
 }
@@ -0,0 +1,50 @@
+// Copyright 2020 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <string.h>
+
+#include "snrt.h"
+
+void *snrt_memset(void *ptr, int value, size_t num) {
+    return memset(ptr, value, num);
+}
+
+/**
+ * @brief Fill `num` bytes with `value`
+ * @details Fills below SNRT_MEMSET_VEC_MIN bytes are done by the core, a word
+ * at a time once aligned. Bigger ones are aligned to the next L1D cacheline
+ * and then written by the vector unit from a register filled with
+ * `vmv.v.x`. Every vector store covers whole cachelines, so the cache never
+ * has to merge a partial line, which makes zeroing buffers run at store
+ * bandwidth.
+ */
+void *memset(void *ptr, int value, size_t num) {
+    uint8_t *p = (uint8_t *)ptr;
+    const uint32_t word = (uint8_t)value * 0x01010101u;
+
+    if (num >= SNRT_MEMSET_VEC_MIN) {
+        size_t vl;
+        // Head up to the next cacheline
+        for (; (uint32_t)p & 3; num--) *p++ = (uint8_t)value;
+        for (; (uint32_t)p & (SNRT_L1D_CACHELINE_BYTES - 1); num -= 4, p += 4)
+            *(uint32_t *)p = word;
+        // Whole lines, plus the words of the last partial one
+        asm volatile("vsetvli %0, %1, e32, m8, ta, ma" : "=r"(vl) : "r"(num / 4));
+        asm volatile("vmv.v.x v0, %0" ::"r"(word));
+        for (; num >= 4; num -= vl * 4, p += vl * 4) {
+            asm volatile("vsetvli %0, %1, e32, m8, ta, ma"
+                         : "=r"(vl)
+                         : "r"(num / 4));
+            asm volatile("vse32.v v0, (%0)" ::"r"(p) : "memory");
+        }
+    } else {
+        for (; num && ((uint32_t)p & 3); num--) *p++ = (uint8_t)value;
+        for (; num >= 4; num -= 4, p += 4) *(uint32_t *)p = word;
+    }
+
+    // Remaining bytes
+    for (size_t i = 0; i < num; ++i) p[i] = (uint8_t)value;
+
+    return ptr;
+}
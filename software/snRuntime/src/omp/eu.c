@@ -6,6 +6,8 @@
 
 #include <stdlib.h>
 
+#include "debug.h"
+#include "encoding.h"
 #include "printf.h"
 #include "snrt.h"
 
@@ -22,15 +24,53 @@
  */
 // #define EU_USE_GLOBAL_CLINT
 
+/**
+ * @brief Number of tasks each core can queue, further tasks are run right
+ * away by the creating core
+ */
+#ifndef EU_TASK_QUEUE_DEPTH
+#define EU_TASK_QUEUE_DEPTH 16
+#endif
+
+/**
+ * @brief Cycles an idle worker polls for the next job before it goes to
+ * sleep, see eu_set_spin_budget
+ */
+#ifndef EU_SPIN_CYCLES
+#define EU_SPIN_CYCLES 2000
+#endif
+
 //================================================================================
 // Types
 //================================================================================
 
+typedef struct {
+    void (*fn)(void *);
+    void *arg;
+} eu_task_t;
+
+/**
+ * @brief Task queue of a core. The owner pushes and pops at the tail, other
+ * cores steal from the head. Each queue has its own lock and cacheline, so
+ * cores only contend when stealing from the same victim. The queues are too
+ * big for the L1 and live in .bss, see eu_task_queues.
+ */
+typedef struct {
+    uint32_t lock;
+    uint32_t head;
+    uint32_t tail;
+    eu_task_t slot[EU_TASK_QUEUE_DEPTH];
+} __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES))) eu_task_queue_t;
+
 typedef struct {
     uint32_t workers_in_loop;
     uint32_t exit_flag;
     uint32_t workers_mutex;
     uint32_t workers_wfi;
+    // bumped to publish a job, the event struct below must not change until
+    // eu_run_empty has seen all workers finish it
+    uint32_t generation;
+    uint32_t spin_budget;
     struct {
         void (*fn)(void *, uint32_t);  // points to microtask wrapper
         void *data;
@@ -56,21 +96,32 @@ __thread volatile eu_t *eu_p;
  */
 static volatile eu_t *volatile eu_p_global;
 
+/**
+ * @brief Task queues of the compute cores, statically allocated as they
+ * would take more than the whole L1
+ */
+static volatile eu_task_queue_t eu_task_queues[SNRT_CLUSTER_MAX_CORES];
+
 //================================================================================
 // prototypes
 //================================================================================
 static void wake_workers(void);
 static void worker_wfi(uint32_t cluster_core_idx);
-static void wait_worker_wfi(void);
+static uint32_t worker_wait(uint32_t cluster_core_idx, uint32_t seen);
 
 //================================================================================
 // public
 //================================================================================
 void eu_init(void) {
     if (snrt_cluster_core_idx() == 0) {
-        // Allocate the eu struct in L1 for fast access
+        // Allocate the eu struct in L1 for fast access, L3 if it is full
         eu_p = snrt_l1alloc(sizeof(eu_t));
+        if (!eu_p) eu_p = snrt_l3alloc(sizeof(eu_t));
+        snrt_assert(eu_p, "eu_init: out of memory\n");
         snrt_memset((void *)eu_p, 0, sizeof(eu_t));
+        snrt_memset((void *)eu_task_queues, 0,
+                    snrt_cluster_compute_core_num() * sizeof(eu_task_queue_t));
+        eu_p->spin_budget = EU_SPIN_CYCLES;
         // store copy of eu_p on shared memory
         eu_p_global = eu_p;
     } else {
@@ -88,16 +139,24 @@ void eu_exit(uint32_t core_idx) {
     // make sure queue is empty
     if (!eu_p->e.nthreads) eu_run_empty(core_idx);
     // set exit flag and wake cores
-    wait_worker_wfi();
     eu_p->exit_flag = 1;
+    __atomic_add_fetch(&eu_p->generation, 1, __ATOMIC_SEQ_CST);
     wake_workers();
 }
 
+/**
+ * @brief Set the number of cycles idle workers poll for a job before they
+ * sleep. Zero sends them to sleep right away.
+ */
+void eu_set_spin_budget(uint32_t cycles) { eu_p->spin_budget = cycles; }
+
 /**
  * @brief Return the number of workers currently present in the event loop
+ * @details Each counted worker has already taken its generation snapshot, see
+ * eu_event_loop.
  */
 uint32_t eu_get_workers_in_loop() {
-    return __atomic_load_n(&eu_p->workers_in_loop, __ATOMIC_RELAXED);
+    return __atomic_load_n(&eu_p->workers_in_loop, __ATOMIC_ACQUIRE);
 }
 
 /**
@@ -124,9 +183,11 @@ void eu_print_status() {
 void eu_event_loop(uint32_t cluster_core_idx) {
     uint32_t scratch;
     uint32_t nthds;
-
-    // count number of workers in loop
-    __atomic_add_fetch(&eu_p->workers_in_loop, 1, __ATOMIC_RELAXED);
+    // Snapshot the generation before being counted in the loop, the release
+    // keeps the load ahead of the count. The master only pushes the first job
+    // once all workers are counted, so none of them can miss it.
+    uint32_t gen = __atomic_load_n(&eu_p->generation, __ATOMIC_ACQUIRE);
+    __atomic_add_fetch(&eu_p->workers_in_loop, 1, __ATOMIC_RELEASE);
 
     // enable software interrupts
 #ifdef EU_USE_GLOBAL_CLINT
@@ -159,9 +220,9 @@ void eu_event_loop(uint32_t cluster_core_idx) {
             eu_p->e.fn(eu_p->e.data, eu_p->e.argc);
         }
 
-        // enter wait for interrupt
+        // wait for the next job
         __atomic_add_fetch(&eu_p->e.fini_count, 1, __ATOMIC_RELAXED);
-        worker_wfi(cluster_core_idx);
+        gen = worker_wait(cluster_core_idx, gen);
     }
 }
 
@@ -176,14 +237,20 @@ void eu_event_loop(uint32_t cluster_core_idx) {
  */
 int eu_dispatch_push(void (*fn)(void *, uint32_t), uint32_t argc, void *data,
                      uint32_t nthreads) {
-    // wait for workers to be in wfi before manipulating the event struct
-    wait_worker_wfi();
-
-    // fill queue
+    // All workers finished the previous job in eu_run_empty, so the event
+    // struct can be filled right away, whether they still poll or sleep
     eu_p->e.fn = fn;
     eu_p->e.data = data;
     eu_p->e.argc = argc;
     eu_p->e.nthreads = nthreads;
+    eu_p->e.fini_count = 0;
+
+    // Publish, polling workers start right away and sleeping ones are woken.
+    // The master runs a job of one thread alone, the workers do not notice.
+    if (nthreads > 1) {
+        __atomic_add_fetch(&eu_p->generation, 1, __ATOMIC_SEQ_CST);
+        wake_workers();
+    }
 
     EU_PRINTF(10, "eu_dispatch_push success, workers %d in loop %d\n", nthreads,
               eu_p->workers_in_loop);
@@ -191,6 +258,80 @@ int eu_dispatch_push(void (*fn)(void *, uint32_t), uint32_t argc, void *data,
     return 0;
 }
 
+/**
+ * @brief Queue a task on the calling core
+ *
+ * @param fn task function
+ * @param arg argument passed to `fn`
+ * @return int 0 on success, -1 if the queue is full
+ */
+int eu_task_push(void (*fn)(void *), void *arg) {
+    volatile eu_task_queue_t *q = &eu_task_queues[snrt_cluster_core_idx()];
+    int ret = -1;
+
+    snrt_mutex_lock(&q->lock);
+    if (q->tail - q->head < EU_TASK_QUEUE_DEPTH) {
+        q->slot[q->tail % EU_TASK_QUEUE_DEPTH].fn = fn;
+        q->slot[q->tail % EU_TASK_QUEUE_DEPTH].arg = arg;
+        q->tail++;
+        ret = 0;
+    }
+    snrt_mutex_release(&q->lock);
+    return ret;
+}
+
+/**
+ * @brief Take the newest (`own`) or the oldest task out of queue `q`
+ * @return 1 if a task was taken, 0 if the queue was empty
+ */
+static int task_take(volatile eu_task_queue_t *q, eu_task_t *t, int own) {
+    // peek first, polling an empty queue must not take its lock
+    if (q->head == q->tail) return 0;
+
+    int ret = 0;
+    snrt_mutex_lock(&q->lock);
+    if (q->head != q->tail) {
+        uint32_t i = (own ? --q->tail : q->head++) % EU_TASK_QUEUE_DEPTH;
+        t->fn = q->slot[i].fn;
+        t->arg = q->slot[i].arg;
+        ret = 1;
+    }
+    snrt_mutex_release(&q->lock);
+    return ret;
+}
+
+/**
+ * @brief Run one queued task
+ * @details The newest task of the calling core is run first, its data is the
+ * most likely to still be cached. Otherwise the oldest task of another core
+ * is stolen, first from the other cores of the calling core's tile, then
+ * from the remaining ones.
+ *
+ * @return int 1 if a task was run, 0 if all queues were empty
+ */
+int eu_task_run(void) {
+    uint32_t self = snrt_cluster_core_idx();
+    uint32_t num = snrt_cluster_compute_core_num();
+    uint32_t per_tile = snrt_cluster_core_num() / snrt_cluster_tile_num();
+    uint32_t tile_first = self - self % per_tile;
+    eu_task_t t;
+
+    int found = task_take(&eu_task_queues[self], &t, 1);
+    // neighbours on the tile
+    for (uint32_t i = 1; !found && i < per_tile; i++) {
+        uint32_t v = tile_first + (self - tile_first + i) % per_tile;
+        if (v < num) found = task_take(&eu_task_queues[v], &t, 0);
+    }
+    // all other cores
+    for (uint32_t i = 1; !found && i < num; i++) {
+        uint32_t v = (self + i) % num;
+        if (v - tile_first >= per_tile)
+            found = task_take(&eu_task_queues[v], &t, 0);
+    }
+    if (found) t.fn(t.arg);
+    return found;
+}
+
 /**
  * @brief supervisor core enters this loop to empty the event queue
  * @details
@@ -201,9 +342,6 @@ void eu_run_empty(uint32_t core_idx) {
     if (!scratch) return;
     EU_PRINTF(10, "eu_run_empty enter: q size %d\n", eu_p->e.nthreads);
 
-    eu_p->e.fini_count = 0;
-    if (scratch > 1) wake_workers();
-
     // Am i also part of the team?
     if (core_idx < eu_p->e.nthreads) {
         // call
@@ -240,10 +378,33 @@ inline void eu_mutex_release() { snrt_mutex_release(&eu_p->workers_mutex); }
 // private
 //================================================================================
 
-static void wait_worker_wfi(void) {
-    uint32_t scratch = eu_p->workers_in_loop;
-    while (__atomic_load_n(&eu_p->workers_wfi, __ATOMIC_RELAXED) != scratch)
-        ;
+/**
+ * @brief Wait for the job after generation `seen`
+ * @details The worker polls the generation for up to spin_budget cycles, so
+ * back-to-back regions start without an interrupt round trip. Only then it
+ * announces itself in workers_wfi and sleeps. The announcement and the
+ * publication of a job are both sequentially consistent, so either the worker
+ * sees the new generation or the master sees it asleep and wakes it. A stale
+ * wake-up only costs another round of the loop.
+ *
+ * @return the generation of the new job
+ */
+static uint32_t worker_wait(uint32_t cluster_core_idx, uint32_t seen) {
+    uint32_t start = read_csr(mcycle);
+    uint32_t gen;
+
+    while ((gen = __atomic_load_n(&eu_p->generation, __ATOMIC_ACQUIRE)) ==
+           seen) {
+        if (read_csr(mcycle) - start < eu_p->spin_budget) continue;
+
+        __atomic_add_fetch(&eu_p->workers_wfi, 1, __ATOMIC_SEQ_CST);
+        while ((gen = __atomic_load_n(&eu_p->generation, __ATOMIC_SEQ_CST)) ==
+               seen)
+            worker_wfi(cluster_core_idx);
+        __atomic_add_fetch(&eu_p->workers_wfi, -1, __ATOMIC_RELAXED);
+        break;
+    }
+    return gen;
 }
 
 /**
@@ -253,6 +414,8 @@ static void wait_worker_wfi(void) {
 #ifdef EU_USE_GLOBAL_CLINT
 
 static void wake_workers(void) {
+    // polling workers see the new generation
+    if (!__atomic_load_n(&eu_p->workers_wfi, __ATOMIC_SEQ_CST)) return;
 #ifdef OMPSTATIC_NUMTHREADS
 #define WAKE_MASK (((1 << OMPSTATIC_NUMTHREADS) - 1) & ~0x1)
     // Fast wake-up for static number of worker threads
@@ -283,11 +446,7 @@ static void wake_workers(void) {
 #endif
 }
 
-static void worker_wfi(uint32_t cluster_core_idx) {
-    __atomic_add_fetch(&eu_p->workers_wfi, 1, __ATOMIC_RELAXED);
-    snrt_int_sw_poll();
-    __atomic_add_fetch(&eu_p->workers_wfi, -1, __ATOMIC_RELAXED);
-}
+static void worker_wfi(uint32_t cluster_core_idx) { snrt_int_sw_poll(); }
 
 /**
  * @brief If we use the wake-up register to wake the worker cores
@@ -296,18 +455,16 @@ static void worker_wfi(uint32_t cluster_core_idx) {
 #else  // #ifdef EU_USE_GLOBAL_CLINT
 
 static void wake_workers(void) {
-    // Guard to wake only if all workers are wfi
-    wait_worker_wfi();
+    // polling workers see the new generation
+    if (!__atomic_load_n(&eu_p->workers_wfi, __ATOMIC_SEQ_CST)) return;
     // Wake the cluster cores. We do this with cluster relative hart IDs and do
     // not wake hart 0 since this is the main thread
     uint32_t numcores = snrt_cluster_compute_core_num();
     snrt_int_cluster_set(~0x1 & ((1 << numcores) - 1));
 }
 static void worker_wfi(uint32_t cluster_core_idx) {
-    __atomic_add_fetch(&eu_p->workers_wfi, 1, __ATOMIC_RELAXED);
     snrt_wfi();
     snrt_int_cluster_clr(1 << cluster_core_idx);
-    __atomic_add_fetch(&eu_p->workers_wfi, -1, __ATOMIC_RELAXED);
 }
 
 #endif  // #ifdef EU_USE_GLOBAL_CLINT
@@ -5,9 +5,11 @@
 #include "kmp.h"
 
 #include <inttypes.h>  // for PRIx##
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "debug.h"
 #include "encoding.h"
 #include "omp.h"
 
@@ -17,14 +19,88 @@ typedef void (*__task_type64)(_kmp_ptr64, _kmp_ptr64, _kmp_ptr64);
 /**
  * @brief Usually the arguments passed to __kmpc_fork_call would do a malloc
  * with the amount of arguments passed. This is too slow for our case and thus
- * we reserve a chunk of arguments in TCDM and use it. This limits the maximum
- * number of arguments
+ * we reserve a chunk of KMP_FORK_MAX_NARGS arguments in TCDM and use it
  *
  */
 _kmp_ptr32 *kmpc_args;
 
+/**
+ * @brief Allocate runtime data in L1, or in L3 once the small L1 is
+ * exhausted. Running out of both halts the core.
+ */
+static void *kmp_alloc(size_t size) {
+    void *ptr = snrt_l1alloc(size);
+    if (!ptr) ptr = snrt_l3alloc(size);
+    snrt_assert(ptr, "kmp_alloc: out of memory for %d bytes\n", size);
+    return ptr;
+}
+
+/// Return a block of kmp_alloc to the memory it was taken from
+static void kmp_free(void *ptr) {
+    snrt_slice_t l1 = snrt_cluster_memory();
+    uint32_t addr = (uint32_t)ptr;
+    if (addr >= l1.start && addr < l1.end)
+        snrt_l1free(ptr);
+    else
+        snrt_l3free(ptr);
+}
+
+/**
+ * @brief Call `fn(gtid, tid, argv[0], ..., argv[argc - 1])`, see microtask.S
+ */
+extern void __kmp_invoke_microtask(kmpc_micro fn, kmp_int32 *gtid,
+                                   kmp_int32 *tid, uint32_t argc,
+                                   _kmp_ptr32 *argv);
+
+/**
+ * @brief Runtime header of a task. `pending` counts the body of an explicit
+ * task and its incomplete children, a task is complete once it drops to
+ * zero. Implicit tasks only count their children.
+ */
+typedef struct kmp_taskdata {
+    struct kmp_taskdata *parent;
+    uint32_t pending;
+    uint32_t implicit;
+    kmp_task_t task __attribute__((aligned(8)));
+} kmp_taskdata_t;
+
+#define KMP_TASKDATA(t) \
+    ((kmp_taskdata_t *)((char *)(t)-offsetof(kmp_taskdata_t, task)))
+
+/**
+ * @brief Nesting depth of the parallel regions of this thread. Regions
+ * nested into another one run serialized with a team of one. Exported for
+ * omp_get_thread_num() and omp_get_num_threads().
+ */
+__thread uint32_t kmp_level;
+
+/// Task this thread executes, NULL outside of parallel regions
+static __thread kmp_taskdata_t *kmp_current_task;
+
+/// Implicit tasks of the outermost parallel region
+static kmp_taskdata_t kmp_implicit_task[SNRT_CLUSTER_MAX_CORES];
+
+#ifndef OMPSTATIC_NUMTHREADS
+static void dispatch_reset(omp_team_t *team);
+
+/// Dynamic loops this thread runs in a team of one
+static __thread omp_team_t kmp_serial_team;
+#endif
+
+/// Whether the thread runs in a team of one, outside of parallel regions or in
+/// a nested one
+static inline int kmp_serialized(void) { return kmp_level != 1; }
+
+/// Thread number in the innermost team
+static inline unsigned kmp_thread_num(void) { return omp_get_thread_num(); }
+
+/// Size of the innermost team
+static inline unsigned kmp_num_threads(void) { return omp_get_num_threads(); }
+
+static void task_wait(kmp_taskdata_t *td);
+
 static void __microtask_wrapper(void *arg, uint32_t argc) {
-    kmp_int32 id = omp_get_thread_num();
+    kmp_int32 id = snrt_cluster_core_idx();
     kmp_int32 *id_addr = (kmp_int32 *)(&id);
 
     // first element in args is the function pointer
@@ -32,66 +108,54 @@ static void __microtask_wrapper(void *arg, uint32_t argc) {
     // second element in args is the pointer to the argument vector
     _kmp_ptr32 *p_argv = &((_kmp_ptr32 *)arg)[1];
     kmp_int32 gtid = id;
+    kmp_taskdata_t *implicit = &kmp_implicit_task[id];
 
     uint32_t cycle = read_csr(mcycle);
     OMP_PROF(if (snrt_hartid() == 1) omp_prof->fork_oh =
                  cycle - omp_prof->fork_oh);
 
-    switch (argc) {
-        default:
-            // printf("Too many args to __microtask_wrapper: %d!\n", argc);
-            snrt_exit(-1);
-        case 0:
-            fn(&gtid, id_addr);
-            break;
-        case 1:
-            fn(&gtid, id_addr, p_argv[0]);
-            break;
-        case 2:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1]);
-            break;
-        case 3:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2]);
-            break;
-        case 4:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3]);
-            break;
-        case 5:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3],
-               p_argv[4]);
-            break;
-        case 6:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3],
-               p_argv[4], p_argv[5]);
-            break;
-        case 7:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3],
-               p_argv[4], p_argv[5], p_argv[6]);
-            break;
-        case 8:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3],
-               p_argv[4], p_argv[5], p_argv[6], p_argv[7]);
-        case 9:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3],
-               p_argv[4], p_argv[5], p_argv[6], p_argv[7], p_argv[8]);
-        case 10:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3],
-               p_argv[4], p_argv[5], p_argv[6], p_argv[7], p_argv[8],
-               p_argv[9]);
-        case 11:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3],
-               p_argv[4], p_argv[5], p_argv[6], p_argv[7], p_argv[8], p_argv[9],
-               p_argv[10]);
-        case 12:
-            fn(&gtid, id_addr, p_argv[0], p_argv[1], p_argv[2], p_argv[3],
-               p_argv[4], p_argv[5], p_argv[6], p_argv[7], p_argv[8], p_argv[9],
-               p_argv[10], p_argv[11]);
-            break;
-    }
+    implicit->pending = 0;
+    implicit->implicit = 1;
+    kmp_current_task = implicit;
+    kmp_level = 1;
+    __kmp_invoke_microtask(fn, &gtid, id_addr, argc, p_argv);
+    // the region ends in an implicit barrier, which completes all its tasks
+    task_wait(implicit);
+    kmp_level = 0;
+    kmp_current_task = NULL;
     // for performance tracking in traces
     cycle = read_csr(mcycle);
 }
 
+/**
+ * @brief Run a region nested into another one on the calling thread
+ * @details All cores of the cluster already run the enclosing region, so the
+ * nested one gets a team of one: it sees thread number zero, barriers return
+ * right away and loops are not split. Its tasks are queued as usual and can
+ * be stolen by the other threads of the enclosing team.
+ */
+static void fork_serialized(kmpc_micro microtask, uint32_t argc,
+                            _kmp_ptr32 *argv) {
+    kmp_int32 gtid = snrt_cluster_core_idx();
+    kmp_int32 tid = 0;
+    kmp_taskdata_t *outer = kmp_current_task;
+    kmp_taskdata_t implicit = {.parent = outer, .pending = 0, .implicit = 1};
+#ifndef OMPSTATIC_NUMTHREADS
+    omp_team_t outer_team = kmp_serial_team;
+    dispatch_reset(&kmp_serial_team);
+#endif
+
+    kmp_current_task = &implicit;
+    kmp_level++;
+    __kmp_invoke_microtask(microtask, &gtid, &tid, argc, argv);
+    task_wait(&implicit);
+    kmp_level--;
+    kmp_current_task = outer;
+#ifndef OMPSTATIC_NUMTHREADS
+    kmp_serial_team = outer_team;
+#endif
+}
+
 /*!
 @ingroup THREAD_STATES
 @param loc Source location information.
@@ -123,8 +187,15 @@ void __kmpc_barrier(ident_t *loc, kmp_int32 tid) {
     (void)tid;
     _OMP_T *_this = omp_getData();
     uint32_t ret;
+    // all tasks of the team complete at the barrier
+    if (kmp_current_task) task_wait(kmp_current_task);
+    if (kmp_serialized()) return;
     KMP_PRINTF(50, "barrier numThreads: %d\n", (uint32_t)_this->numThreads);
+#ifdef OMP_SENSE_BARRIER
+    snrt_sense_barrier(_this->kmpc_barrier, (uint32_t)_this->numThreads);
+#else
     snrt_barrier(_this->kmpc_barrier, (uint32_t)_this->numThreads);
+#endif
 }
 
 /*!
@@ -173,15 +244,18 @@ void __kmpc_fork_call(ident_t *loc, kmp_int32 argc, kmpc_micro microtask, ...) {
     arg_size = (argc + 1) * sizeof(_kmp_ptr32);
 
     // Do not alloc for argument pointers but use the statically alllocated
-    // kmpc_args
-    // void *args = rt_malloc(arg_size); for(int i = 0; i < arg_size;
-    // i ++) ((uint8_t*)args)[i]=0;
+    // kmpc_args, only regions capturing more variables than it holds pay for
+    // an allocation. So do nested regions, the enclosing one may still be
+    // reading kmpc_args.
+    _kmp_ptr32 *args = kmpc_args;
+    if (kmp_level || argc + 1 > KMP_FORK_MAX_NARGS)
+        args = kmp_alloc(arg_size);
     // first element holds pointer to the microtask
-    kmpc_args[0] = (_kmp_ptr32)microtask;
+    args[0] = (_kmp_ptr32)microtask;
     // copy remaining varargs
     va_start(vl, microtask);
     for (int i = 1; i <= argc; ++i) {
-        kmpc_args[i] = (_kmp_ptr32)va_arg(vl, _kmp_ptr32);
+        args[i] = (_kmp_ptr32)va_arg(vl, _kmp_ptr32);
     }
     va_end(vl);
 
@@ -190,22 +264,17 @@ void __kmpc_fork_call(ident_t *loc, kmp_int32 argc, kmpc_micro microtask, ...) {
                "microtask @%#x\n",
                argc, omp->numThreads, omp->numThreads, (uint32_t)microtask);
 
-    /// a worker enters this fork call: this means nested parallelism
-    if (snrt_cluster_core_idx() != 0) {
-        KMP_PRINTF(0, "error: nested parallelism\n");
-        snrt_exit(-1);
-        /// TODO: This almost works. The problem is, that the current task in
-        /// the EU is not yet completed (due to this thread forking). Correctly,
-        /// this thread woul re-enter the event queue, run the newly dispatched
-        /// thread and then return to this thread. If this is not done, the
-        /// nested parallelism is not executed in the correct order
-        (void)eu_dispatch_push(__microtask_wrapper, argc, kmpc_args,
-                               omp->numThreads);
+    if (kmp_level) {
+        // nested parallelism
+        fork_serialized(microtask, argc, &args[1]);
     } else {
-        parallelRegion(argc, kmpc_args, __microtask_wrapper, omp->numThreads);
+#ifndef OMPSTATIC_NUMTHREADS
+        dispatch_reset(omp_get_team(omp));
+#endif
+        parallelRegion(argc, args, __microtask_wrapper, omp->numThreads);
     }
 
-    // rt_free(args);
+    if (args != kmpc_args) kmp_free(args);
 }
 
 /*!
@@ -238,7 +307,8 @@ void __kmpc_for_static_init_4(ident_t *loc, kmp_int32 gtid,
     (void)gtid;
     _OMP_T *omp = omp_getData();
     _OMP_TEAM_T *team = omp_get_team(omp);
-    unsigned threadNum = omp_get_thread_num();
+    unsigned threadNum = kmp_thread_num();
+    unsigned nbThreads = kmp_serialized() ? 1 : team->nbThreads;
     kmp_uint32 loopSize = (*pupper - *plower) / incr + 1;
     kmp_int32 globalUpper = *pupper;
 
@@ -255,7 +325,7 @@ void __kmpc_for_static_init_4(ident_t *loc, kmp_int32 gtid,
     if (sched == kmp_sch_static_chunked) {
         KMP_PRINTF(50, "    sched: static_chunked\n");
         int span = incr * chunk;
-        *pstride = span * team->nbThreads;
+        *pstride = span * nbThreads;
         *plower = *plower + span * threadNum;
         *pupper = *plower + span - incr;
         int beginLastChunk = globalUpper - (globalUpper % span);
@@ -265,8 +335,8 @@ void __kmpc_for_static_init_4(ident_t *loc, kmp_int32 gtid,
     // no specified chunk size
     else if (sched == kmp_sch_static) {
         KMP_PRINTF(50, "    sched: static\n");
-        chunk = loopSize / team->nbThreads;
-        int leftOver = loopSize - chunk * team->nbThreads;
+        chunk = loopSize / nbThreads;
+        int leftOver = loopSize - chunk * nbThreads;
 
         // calculate precise chunk size and lower and upper bound
         if ((int)threadNum < leftOver) {
@@ -281,7 +351,7 @@ void __kmpc_for_static_init_4(ident_t *loc, kmp_int32 gtid,
         *pstride = loopSize;
 
         KMP_PRINTF(50, "    team thds: %d chunk: %d leftOver: %d\n",
-                   team->nbThreads, chunk, leftOver);
+                   nbThreads, chunk, leftOver);
     }
 
     KMP_PRINTF(10,
@@ -323,7 +393,8 @@ void __kmpc_for_static_init_8u(ident_t *loc, kmp_int32 gtid, kmp_int32 sched,
     (void)gtid;
     _OMP_T *omp = omp_getData();
     _OMP_TEAM_T *team = omp_get_team(omp);
-    unsigned threadNum = omp_get_thread_num();
+    unsigned threadNum = kmp_thread_num();
+    unsigned nbThreads = kmp_serialized() ? 1 : team->nbThreads;
     kmp_uint64 loopSize = (*pupper - *plower) / incr + 1;
     kmp_uint64 globalUpper = *pupper;
 
@@ -341,7 +412,7 @@ void __kmpc_for_static_init_8u(ident_t *loc, kmp_int32 gtid, kmp_int32 sched,
     if (sched == kmp_sch_static_chunked) {
         KMP_PRINTF(50, "    sched: static_chunked\n");
         kmp_int64 span = incr * chunk;
-        *pstride = span * team->nbThreads;
+        *pstride = span * nbThreads;
         *plower = *plower + span * threadNum;
         *pupper = *plower + span - incr;
         kmp_int64 beginLastChunk = globalUpper - (globalUpper % span);
@@ -351,8 +422,8 @@ void __kmpc_for_static_init_8u(ident_t *loc, kmp_int32 gtid, kmp_int32 sched,
     // no specified chunk size
     else if (sched == kmp_sch_static) {
         KMP_PRINTF(50, "    sched: static\n");
-        chunk = loopSize / team->nbThreads;
-        kmp_int64 leftOver = loopSize - chunk * team->nbThreads;
+        chunk = loopSize / nbThreads;
+        kmp_int64 leftOver = loopSize - chunk * nbThreads;
 
         // calculate precise chunk size and lower and upper bound
         if (threadNum < leftOver) {
@@ -368,7 +439,7 @@ void __kmpc_for_static_init_8u(ident_t *loc, kmp_int32 gtid, kmp_int32 sched,
 
         KMP_PRINTF(
             50, "    team thds: %d chunk: %" PRId64 " leftOver: %" PRId64 "\n",
-            team->nbThreads, chunk, leftOver);
+            nbThreads, chunk, leftOver);
     }
 
     KMP_PRINTF(10,
@@ -378,12 +449,541 @@ void __kmpc_for_static_init_8u(ident_t *loc, kmp_int32 gtid, kmp_int32 sched,
                *plastiter, *plower, *pupper, incr, *pstride, chunk);
 }
 
+/*!
+ See @ref __kmpc_for_static_init_4
+ */
+void __kmpc_for_static_init_8(ident_t *loc, kmp_int32 gtid, kmp_int32 sched,
+                              kmp_int32 *plastiter, kmp_int64 *plower,
+                              kmp_int64 *pupper, kmp_int64 *pstride,
+                              kmp_int64 incr, kmp_int64 chunk) {
+    (void)loc;
+    (void)gtid;
+    _OMP_T *omp = omp_getData();
+    _OMP_TEAM_T *team = omp_get_team(omp);
+    unsigned threadNum = kmp_thread_num();
+    unsigned nbThreads = kmp_serialized() ? 1 : team->nbThreads;
+    // the span of a 64-bit space may not fit its signed type
+    kmp_uint64 loopSize =
+        incr > 0 ? ((kmp_uint64)*pupper - (kmp_uint64)*plower) / incr + 1
+                 : ((kmp_uint64)*plower - (kmp_uint64)*pupper) /
+                           -(kmp_uint64)incr +
+                       1;
+    kmp_int64 globalUpper = *pupper;
+
+    KMP_PRINTF(50,
+               "__kmpc_for_static_init_8 gtid %d schedtype %d incr %" PRId64
+               " chunk %" PRId64 "\n",
+               gtid, sched, incr, chunk);
+    KMP_PRINTF(50, "    loopsize %" PRIu64 "\n", loopSize);
+
+    // chunk size is specified
+    if (sched == kmp_sch_static_chunked) {
+        KMP_PRINTF(50, "    sched: static_chunked\n");
+        kmp_int64 span = incr * chunk;
+        *pstride = span * nbThreads;
+        *plower = *plower + span * threadNum;
+        *pupper = *plower + span - incr;
+        kmp_int64 beginLastChunk = globalUpper - (globalUpper % span);
+        *plastiter = ((beginLastChunk - *plower) % *pstride) == 0;
+    }
+
+    // no specified chunk size
+    else if (sched == kmp_sch_static) {
+        KMP_PRINTF(50, "    sched: static\n");
+        kmp_uint64 uchunk = loopSize / nbThreads;
+        kmp_uint64 leftOver = loopSize - uchunk * nbThreads;
+
+        // calculate precise chunk size and lower and upper bound
+        if (threadNum < leftOver) {
+            uchunk++;
+            *plower = *plower + threadNum * uchunk * incr;
+        } else
+            *plower = *plower + (threadNum * uchunk + leftOver) * incr;
+        *pupper = *plower + uchunk * incr - incr;
+        chunk = uchunk;
+
+        // a thread without iterations ends right before the last one
+        if (plastiter != NULL)
+            *plastiter = (uchunk != 0 && *pupper == globalUpper);
+        *pstride = loopSize;
+    }
+
+    KMP_PRINTF(10,
+               "__kmpc_for_static_init_8 plast %4" PRId32 "p[l %4" PRId64
+               ", u %4" PRId64 ", i %4" PRId64 ", str %4" PRId64
+               "] chunk %" PRId64 "\n",
+               *plastiter, *plower, *pupper, incr, *pstride, chunk);
+}
+
+//================================================================================
+// Reductions
+//================================================================================
+
+/**
+ * @brief One slot per thread for the reduction tree, each on its own
+ * cacheline. `data` holds the reduce_data of a thread that waits for its
+ * partner to combine it and is cleared once that is done.
+ */
+static struct {
+    void *volatile data;
+} __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES)))
+kmp_reduce_slot[SNRT_CLUSTER_MAX_CORES];
+
+/// Bumped by the master in __kmpc_end_reduce to release the team
+static volatile uint32_t kmp_reduce_release;
+/// Whether the last blocking reduce of this thread took the atomic path
+static __thread int kmp_reduce_atomic;
+
+/**
+ * @brief Combine the private copies of all threads into the one of thread 0
+ * @details Binary tree over the thread ids: in the round of distance `d`,
+ * thread `t` with bit `d` set hands its data to thread `t - d` and leaves,
+ * the others combine the data of `t + d` into theirs. Threads of a tile
+ * are numbered contiguously, so the first rounds stay within a tile and
+ * only the tile leaders combine across the cluster. No round waits for more
+ * than one thread and no lock is taken.
+ *
+ * @return one on thread 0, which holds the result, zero on all others
+ */
+static kmp_int32 reduce_tree(void *reduce_data,
+                             void (*reduce_func)(void *lhs_data,
+                                                 void *rhs_data)) {
+    uint32_t tid = kmp_thread_num();
+    uint32_t n = kmp_num_threads();
+
+    for (uint32_t d = 1; d < n; d <<= 1) {
+        if (tid & d) {
+            __atomic_store_n(&kmp_reduce_slot[tid].data, reduce_data,
+                             __ATOMIC_RELEASE);
+            // the private copies go out of scope once we return
+            while (__atomic_load_n(&kmp_reduce_slot[tid].data,
+                                   __ATOMIC_ACQUIRE))
+                ;
+            return 0;
+        }
+        if (tid + d < n) {
+            void *rhs;
+            while (!(rhs = __atomic_load_n(&kmp_reduce_slot[tid + d].data,
+                                           __ATOMIC_ACQUIRE)))
+                ;
+            reduce_func(reduce_data, rhs);
+            __atomic_store_n(&kmp_reduce_slot[tid + d].data, NULL,
+                             __ATOMIC_RELEASE);
+        }
+    }
+    return 1;
+}
+
+/// A single scalar of at most 32 bits can be updated with one AMO
+static inline int reduce_use_atomic(ident_t *loc, kmp_int32 num_vars,
+                                    size_t reduce_size) {
+    return loc && (loc->flags & KMP_IDENT_ATOMIC_REDUCE) && num_vars == 1 &&
+           reduce_size <= sizeof(kmp_int32);
+}
+
+/*!
+@ingroup SYNCHRONIZATION
+@param loc source location information.
+@param global_tid global thread number.
+@param num_vars number of items (variables) to be reduced
+@param reduce_size size of data in bytes to be reduced
+@param reduce_data pointer to data to be reduced
+@param reduce_func callback function providing reduction operation on two
+operands and returning result of reduction in lhs_data
+@param lck pointer to the unique lock data structure
+@result 1 for the master thread, 0 for all other team threads, 2 for all team
+threads if atomic reduction needed
+
+The nowait version is used for a reduce clause with the nowait argument.
+Scalar reductions of at most 32 bits that the compiler can also express as
+atomics (e.g. integer sums) take the atomic path: every thread updates the
+shared variable with a single AMO. All others are combined in a tree, see
+reduce_tree.
+*/
+kmp_int32 __kmpc_reduce_nowait(ident_t *loc, kmp_int32 global_tid,
+                               kmp_int32 num_vars, size_t reduce_size,
+                               void *reduce_data,
+                               void (*reduce_func)(void *lhs_data,
+                                                   void *rhs_data),
+                               kmp_critical_name *lck) {
+    (void)global_tid;
+    (void)lck;
+    KMP_PRINTF(10, "__kmpc_reduce_nowait: num_vars %d size %d\n", num_vars,
+               reduce_size);
+    if (reduce_use_atomic(loc, num_vars, reduce_size)) return 2;
+    return reduce_tree(reduce_data, reduce_func);
+}
+
+/*!
+@ingroup SYNCHRONIZATION
+@param loc source location information
+@param global_tid global thread id.
+@param lck pointer to the unique lock data structure
+
+Finish the execution of a reduce nowait, nothing to do here.
+*/
+void __kmpc_end_reduce_nowait(ident_t *loc, kmp_int32 global_tid,
+                              kmp_critical_name *lck) {
+    (void)loc;
+    (void)global_tid;
+    (void)lck;
+}
+
+/*!
+@ingroup SYNCHRONIZATION
+@param loc source location information
+@param global_tid global thread number
+@param num_vars number of items (variables) to be reduced
+@param reduce_size size of data in bytes to be reduced
+@param reduce_data pointer to data to be reduced
+@param reduce_func callback function providing reduction operation on two
+operands and returning result of reduction in lhs_data
+@param lck pointer to the unique lock data structure
+@result 1 for the master thread, 0 for all other team threads, 2 for all team
+threads if atomic reduction needed
+
+A blocking reduce that includes an implicit barrier: the threads that return
+zero wait until the master has stored the result in __kmpc_end_reduce.
+*/
+kmp_int32 __kmpc_reduce(ident_t *loc, kmp_int32 global_tid, kmp_int32 num_vars,
+                        size_t reduce_size, void *reduce_data,
+                        void (*reduce_func)(void *lhs_data, void *rhs_data),
+                        kmp_critical_name *lck) {
+    (void)global_tid;
+    (void)lck;
+    KMP_PRINTF(10, "__kmpc_reduce: num_vars %d size %d\n", num_vars,
+               reduce_size);
+    kmp_reduce_atomic = reduce_use_atomic(loc, num_vars, reduce_size);
+    if (kmp_reduce_atomic) return 2;
+
+    // the master cannot release us before we handed over our data
+    uint32_t release = kmp_reduce_release;
+    kmp_int32 ret = reduce_tree(reduce_data, reduce_func);
+    if (!ret)
+        while (kmp_reduce_release == release)
+            ;
+    return ret;
+}
+
+/*!
+@ingroup SYNCHRONIZATION
+@param loc source location information
+@param global_tid global thread ID
+@param lck pointer to the unique lock data structure
+
+Finish the execution of a blocking reduce. Called by the master after storing
+the result, or by all threads after their atomic update.
+*/
+void __kmpc_end_reduce(ident_t *loc, kmp_int32 global_tid,
+                       kmp_critical_name *lck) {
+    (void)lck;
+    // nobody waits on a team of one
+    if (kmp_serialized()) return;
+    // on the atomic path all threads get here
+    if (kmp_reduce_atomic)
+        __kmpc_barrier(loc, global_tid);
+    else
+        __atomic_fetch_add(&kmp_reduce_release, 1, __ATOMIC_RELEASE);
+}
+
+//================================================================================
+// Tasks
+//================================================================================
+
+/**
+ * @brief Drop one reference of `td`, the body or a child. A complete
+ * explicit task is freed and drops its reference of the parent.
+ */
+static void task_release(kmp_taskdata_t *td) {
+    while (td && __atomic_sub_fetch(&td->pending, 1, __ATOMIC_ACQ_REL) == 0 &&
+           !td->implicit) {
+        kmp_taskdata_t *parent = td->parent;
+        kmp_free(td);
+        td = parent;
+    }
+}
+
+/// Event unit entry point of a queued task
+static void task_run(void *arg) {
+    kmp_taskdata_t *td = (kmp_taskdata_t *)arg;
+    kmp_taskdata_t *outer = kmp_current_task;
+
+    kmp_current_task = td;
+    td->task.routine(snrt_cluster_core_idx(), &td->task);
+    kmp_current_task = outer;
+    task_release(td);
+}
+
+/**
+ * @brief Wait for all children of `td` and their descendants, running queued
+ * tasks of any thread in the meantime
+ */
+static void task_wait(kmp_taskdata_t *td) {
+    uint32_t body = !td->implicit;
+    while (__atomic_load_n(&td->pending, __ATOMIC_ACQUIRE) > body)
+        eu_task_run();
+}
+
+/*!
+@ingroup TASKING
+@param loc_ref source location information
+@param gtid global thread number.
+@param flags include tiedness & task type (explicit vs. implicit) of the ''new''
+task encountered. Converted from kmp_int32 to kmp_tasking_flags_t in routine.
+@param sizeof_kmp_task_t  Size in bytes of kmp_task_t data structure including
+private vars accessed in task.
+@param sizeof_shareds  Size in bytes of array of pointers to shared vars
+accessed in task.
+@param task_entry Pointer to task code entry point generated by compiler.
+@return a pointer to task structure or NULL if out of memory.
+*/
+kmp_task_t *__kmpc_omp_task_alloc(ident_t *loc_ref, kmp_int32 gtid,
+                                  kmp_int32 flags, size_t sizeof_kmp_task_t,
+                                  size_t sizeof_shareds,
+                                  kmp_routine_entry_t task_entry) {
+    (void)loc_ref;
+    (void)gtid;
+    (void)flags;
+    size_t task_size =
+        (sizeof_kmp_task_t + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    // L1 only holds a handful of descriptors, further ones spill to L3
+    kmp_taskdata_t *td = kmp_alloc(offsetof(kmp_taskdata_t, task) +
+                                   task_size + sizeof_shareds);
+    if (!td) {
+        KMP_PRINTF(0, "error: out of memory for a task\n");
+        return NULL;
+    }
+
+    td->parent = kmp_current_task;
+    td->pending = 1;
+    td->implicit = 0;
+    td->task.shareds = sizeof_shareds ? (char *)&td->task + task_size : NULL;
+    td->task.routine = task_entry;
+    td->task.part_id = 0;
+    KMP_PRINTF(10, "__kmpc_omp_task_alloc: task @%#x size %d shareds %d\n",
+               (uint32_t)&td->task, sizeof_kmp_task_t, sizeof_shareds);
+    return &td->task;
+}
+
+/*!
+@ingroup TASKING
+@param loc_ref location of the original task directive
+@param gtid Global Thread ID of encountering thread
+@param new_task task thunk allocated by __kmpc_omp_task_alloc() for the ''new
+task''
+@return Returns TASK_CURRENT_NOT_QUEUED (0), the encountering task continues.
+
+Queue the task on the event unit of the encountering core, from where idle
+threads of the team steal it. Outside of parallel regions, or if the queue is
+full, the task is run right away.
+*/
+kmp_int32 __kmpc_omp_task(ident_t *loc_ref, kmp_int32 gtid,
+                          kmp_task_t *new_task) {
+    (void)loc_ref;
+    (void)gtid;
+    kmp_taskdata_t *td = KMP_TASKDATA(new_task);
+
+    if (td->parent)
+        __atomic_add_fetch(&td->parent->pending, 1, __ATOMIC_RELAXED);
+    if (!kmp_level || eu_task_push(task_run, td)) task_run(td);
+    return 0;
+}
+
+/*!
+@ingroup TASKING
+@param loc_ref source location information
+@param gtid global thread number
+@param task task thunk allocated by __kmpc_omp_task_alloc()
+
+Start an undeferred task (if clause false), the compiler calls its entry point
+right after.
+*/
+void __kmpc_omp_task_begin_if0(ident_t *loc_ref, kmp_int32 gtid,
+                               kmp_task_t *task) {
+    (void)loc_ref;
+    (void)gtid;
+    kmp_taskdata_t *td = KMP_TASKDATA(task);
+
+    if (td->parent)
+        __atomic_add_fetch(&td->parent->pending, 1, __ATOMIC_RELAXED);
+    kmp_current_task = td;
+}
+
+/*!
+@ingroup TASKING
+@param loc_ref source location information; points to end of task block.
+@param gtid global thread number.
+@param task task thunk for the completed task.
+
+Finish an undeferred task.
+*/
+void __kmpc_omp_task_complete_if0(ident_t *loc_ref, kmp_int32 gtid,
+                                  kmp_task_t *task) {
+    (void)loc_ref;
+    (void)gtid;
+    kmp_taskdata_t *td = KMP_TASKDATA(task);
+
+    kmp_current_task = td->parent;
+    task_release(td);
+}
+
+/*!
+@ingroup TASKING
+@param loc_ref location of the taskwait directive
+@param gtid global thread number
+@return 0
+
+Wait for the children of the current task to complete. The thread runs other
+queued tasks meanwhile.
+*/
+kmp_int32 __kmpc_omp_taskwait(ident_t *loc_ref, kmp_int32 gtid) {
+    (void)loc_ref;
+    (void)gtid;
+    if (kmp_current_task) task_wait(kmp_current_task);
+    return 0;
+}
+
+/*!
+@ingroup TASKING
+@param loc_ref location of the taskyield directive
+@param gtid global thread number
+@param end_part unused
+@return 0
+
+Run one queued task, if there is any.
+*/
+kmp_int32 __kmpc_omp_taskyield(ident_t *loc_ref, kmp_int32 gtid,
+                               int end_part) {
+    (void)loc_ref;
+    (void)gtid;
+    (void)end_part;
+    if (kmp_level) eu_task_run();
+    return 0;
+}
+
 //================================================================================
 // Dynamic scheduling
 // Only available if not OMPSTATIC_NUMTHREADS
 //================================================================================
 #ifndef OMPSTATIC_NUMTHREADS
 
+/**
+ * @brief Restart the loop epochs, called by the master before every fork
+ * @details All threads of a region enter the same sequence of dynamic loops,
+ * so their epochs agree as long as they start from zero in every region,
+ * whichever threads took part in the previous one.
+ */
+static void dispatch_reset(omp_team_t *team) {
+    team->loop_epoch = 0;
+    team->loop_claim = 0;
+    for (unsigned i = 0;
+         i < sizeof(team->core_epoch) / sizeof(team->core_epoch[0]); i++)
+        team->core_epoch[i] = 0;
+}
+
+/// Team whose loops the calling thread shares
+static inline omp_team_t *dispatch_team(void) {
+    return kmp_serialized() ? &kmp_serial_team : omp_get_team(omp_getData());
+}
+
+/**
+ * @brief Set up a dynamically scheduled loop, shared by all dispatch_init
+ * @details The first thread to enter a loop claims its epoch with a CAS and
+ * publishes the loop once all threads have drained the previous one, the
+ * others wait for the epoch to be published. No lock is taken.
+ *
+ * The iteration space is normalized to iterations 0 to `last` in 64 bits,
+ * which also covers the full range of a 64-bit type whose trip count wraps to
+ * zero. The chunk counter is 32-bit for amoadd, a space of more than 2^31
+ * chunks gets proportionally bigger chunks.
+ *
+ * @param is_signed compare the bounds as signed integers
+ */
+static void dispatch_init(enum sched_type schedule, kmp_uint64 lb,
+                          kmp_uint64 ub, kmp_int64 st, kmp_int64 chunk,
+                          int is_signed) {
+    omp_team_t *team = dispatch_team();
+    int epoch = ++team->core_epoch[kmp_thread_num()];
+    int prev = epoch - 1;
+
+    if (!__atomic_compare_exchange_n(&team->loop_claim, &prev, epoch, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        while (__atomic_load_n(&team->loop_epoch, __ATOMIC_ACQUIRE) != epoch)
+            ;
+        return;
+    }
+
+    // a thread may still fetch from the previous loop with nowait
+    while (__atomic_load_n(&team->loop_left, __ATOMIC_ACQUIRE))
+        ;
+
+    int empty = is_signed ? (st > 0 ? (kmp_int64)ub < (kmp_int64)lb
+                                    : (kmp_int64)ub > (kmp_int64)lb)
+                          : (st > 0 ? ub < lb : ub > lb);
+    kmp_uint64 last = 0;
+    if (!empty) last = st > 0 ? (ub - lb) / st : (lb - ub) / -(kmp_uint64)st;
+    kmp_uint64 csize = chunk < 1 ? 1 : chunk;
+    if (last / csize >= (1u << 31) - 1) csize = last / ((1u << 31) - 1) + 1;
+
+    team->loop_start = lb;
+    team->loop_incr = st;
+    team->loop_last = last;
+    team->loop_chunk = csize;
+    team->loop_nchunks = empty ? 0 : last / csize + 1;
+    team->loop_sched = SCHEDULE_WITHOUT_MODIFIERS(schedule);
+    team->loop_next = 0;
+    team->loop_left = kmp_num_threads();
+    __atomic_store_n(&team->loop_epoch, epoch, __ATOMIC_RELEASE);
+    KMP_PRINTF(10, "dispatch_init setup: last %d chunk %d sched %d\n",
+               (uint32_t)last, (uint32_t)csize, team->loop_sched);
+}
+
+/**
+ * @brief Claim the next chunk of the current loop, shared by all
+ * dispatch_next
+ * @details Dynamic chunks are handed out with a single amoadd on the chunk
+ * counter. Guided ones take remaining / (2 * threads) chunks, but at least
+ * one, with a CAS on the same counter.
+ *
+ * @return one and the bounds of the chunk, zero if the loop is drained
+ */
+static int dispatch_next(kmp_int32 *p_last, kmp_uint64 *p_lb,
+                         kmp_uint64 *p_ub) {
+    omp_team_t *team = dispatch_team();
+    kmp_uint32 nchunks = team->loop_nchunks;
+    kmp_uint32 c, n = 1;
+
+    if (team->loop_sched == kmp_sch_guided_chunked ||
+        team->loop_sched == kmp_sch_guided_iterative_chunked ||
+        team->loop_sched == kmp_sch_guided_analytical_chunked) {
+        c = __atomic_load_n(&team->loop_next, __ATOMIC_RELAXED);
+        do {
+            if (c >= nchunks) goto done;
+            n = (nchunks - c) / (2 * kmp_num_threads());
+            if (!n) n = 1;
+        } while (!__atomic_compare_exchange_n(&team->loop_next, &c, c + n, 1,
+                                              __ATOMIC_RELAXED,
+                                              __ATOMIC_RELAXED));
+    } else {
+        c = __atomic_fetch_add(&team->loop_next, 1, __ATOMIC_RELAXED);
+        if (c >= nchunks) goto done;
+    }
+
+    // clamp to the last iteration without overflowing past it
+    kmp_uint64 first = (kmp_uint64)c * team->loop_chunk;
+    kmp_uint64 last = team->loop_last;
+    if (n <= (last - first) / team->loop_chunk)
+        last = first + n * team->loop_chunk - 1;
+    *p_lb = team->loop_start + first * team->loop_incr;
+    *p_ub = team->loop_start + last * team->loop_incr;
+    *p_last = (last == team->loop_last);
+    return 1;
+
+done:
+    __atomic_fetch_sub(&team->loop_left, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
 /*!
 @ingroup WORK_SHARING
 @{
@@ -404,32 +1004,9 @@ void __kmpc_dispatch_init_4(ident_t *loc, kmp_int32 gtid,
                             kmp_int32 ub, kmp_int32 st, kmp_int32 chunk) {
     (void)loc;
     (void)gtid;
-    (void)schedule;
-    omp_team_t *team = omp_get_team(omp_getData());
-    // dynLoopInitNoIter(team, lb, ub, st, chunk);
-    // int core_id = omp_get_thread_num();
-    eu_mutex_lock();
-    // if (team->loop_epoch - team->core_epoch[core_id] != 0)
-    // {
-    //   eu_mutex_release();
-    //   team->core_epoch[core_id]++;
-    //   KMP_PRINTF(10, "__kmpc_dispatch_init_4 core_epoch[%d] =
-    //   %d\n",core_id,team->core_epoch[core_id]); return;
-    // }
-
-    if (!team->loop_is_setup) {
-        team->loop_is_setup = 1;
-        team->loop_start = lb;
-        team->loop_end = ub;
-        team->loop_incr = st;
-        team->loop_chunk = chunk;
-        KMP_PRINTF(
-            10,
-            "__kmpc_dispatch_init_4 setup: start %d end %d incr %d chunk %d\n",
-            team->loop_start, team->loop_end, team->loop_incr,
-            team->loop_chunk);
-    }
-    eu_mutex_release();
+    KMP_PRINTF(10, "__kmpc_dispatch_init_4: start %d end %d incr %d chunk %d\n",
+               lb, ub, st, chunk);
+    dispatch_init(schedule, (kmp_int64)lb, (kmp_int64)ub, st, chunk, 1);
 }
 
 /*!
@@ -438,9 +1015,31 @@ See @ref __kmpc_dispatch_init_4
 void __kmpc_dispatch_init_4u(ident_t *loc, kmp_int32 gtid,
                              enum sched_type schedule, kmp_uint32 lb,
                              kmp_uint32 ub, kmp_int32 st, kmp_int32 chunk) {
-    kmp_int32 ilb = (kmp_int32)lb;
-    kmp_int32 iub = (kmp_int32)ub;
-    __kmpc_dispatch_init_4(loc, gtid, schedule, ilb, iub, st, chunk);
+    (void)loc;
+    (void)gtid;
+    dispatch_init(schedule, lb, ub, st, chunk, 0);
+}
+
+/*!
+See @ref __kmpc_dispatch_init_4
+*/
+void __kmpc_dispatch_init_8(ident_t *loc, kmp_int32 gtid,
+                            enum sched_type schedule, kmp_int64 lb,
+                            kmp_int64 ub, kmp_int64 st, kmp_int64 chunk) {
+    (void)loc;
+    (void)gtid;
+    dispatch_init(schedule, lb, ub, st, chunk, 1);
+}
+
+/*!
+See @ref __kmpc_dispatch_init_4
+*/
+void __kmpc_dispatch_init_8u(ident_t *loc, kmp_int32 gtid,
+                             enum sched_type schedule, kmp_uint64 lb,
+                             kmp_uint64 ub, kmp_int64 st, kmp_int64 chunk) {
+    (void)loc;
+    (void)gtid;
+    dispatch_init(schedule, lb, ub, st, chunk, 0);
 }
 
 /*!
@@ -460,53 +1059,66 @@ int __kmpc_dispatch_next_4(ident_t *loc, kmp_int32 gtid, kmp_int32 *p_last,
                            kmp_int32 *p_lb, kmp_int32 *p_ub, kmp_int32 *p_st) {
     (void)loc;
     (void)gtid;
+    kmp_uint64 lb, ub;
 
-    omp_team_t *team = omp_get_team(omp_getData());
-
+    if (!dispatch_next(p_last, &lb, &ub)) return 0;
     // The stride is actually always 1
     *p_st = 1;
+    *p_lb = (kmp_int32)lb;
+    *p_ub = (kmp_int32)ub;
+    KMP_PRINTF(10, "__kmpc_dispatch_next_4 : last: %d [l %4d u %4d s %4d]\n",
+               *p_last, *p_lb, *p_ub, *p_st);
+    return 1;
+}
 
-    // int result = dynLoopIter(team, (int*) p_lb, (int*) p_ub, (int*) p_last);
-    eu_mutex_lock();
+/*!
+See @ref __kmpc_dispatch_next_4
+*/
+int __kmpc_dispatch_next_4u(ident_t *loc, kmp_int32 gtid, kmp_int32 *p_last,
+                            kmp_uint32 *p_lb, kmp_uint32 *p_ub,
+                            kmp_int32 *p_st) {
+    (void)loc;
+    (void)gtid;
+    kmp_uint64 lb, ub;
 
-    // have already iterated over all the iterations(no more work), return 0
-    if (team->loop_start > team->loop_end) {
-        team->loop_is_setup = 0;
-        KMP_PRINTF(
-            10, "__kmpc_dispatch_next_4 start > end: team->loop_is_setup %d\n",
-            team->loop_is_setup);
-        eu_mutex_release();
-        return 0;
-    }
+    if (!dispatch_next(p_last, &lb, &ub)) return 0;
+    *p_st = 1;
+    *p_lb = (kmp_uint32)lb;
+    *p_ub = (kmp_uint32)ub;
+    return 1;
+}
 
-    *p_lb = team->loop_start;
-    *p_ub = *p_lb + team->loop_chunk - 1;
-    if (*p_ub >= team->loop_end) {
-        *p_ub = team->loop_end;
-        *p_last = 1;
-    }
+/*!
+See @ref __kmpc_dispatch_next_4
+*/
+int __kmpc_dispatch_next_8(ident_t *loc, kmp_int32 gtid, kmp_int32 *p_last,
+                           kmp_int64 *p_lb, kmp_int64 *p_ub, kmp_int64 *p_st) {
+    (void)loc;
+    (void)gtid;
+    kmp_uint64 lb, ub;
 
-    team->loop_start += team->loop_chunk;
-    KMP_PRINTF(10,
-               "__kmpc_dispatch_next_4 : last: %d [l %4d u %4d s %4d] "
-               "team->loop_start %d\n",
-               *p_last, *p_lb, *p_ub, *p_st, team->loop_start);
-    eu_mutex_release();
+    if (!dispatch_next(p_last, &lb, &ub)) return 0;
+    *p_st = 1;
+    *p_lb = (kmp_int64)lb;
+    *p_ub = (kmp_int64)ub;
     return 1;
 }
 
 /*!
 See @ref __kmpc_dispatch_next_4
 */
-int __kmpc_dispatch_next_4u(ident_t *loc, kmp_int32 gtid, kmp_int32 *p_last,
-                            kmp_uint32 *p_lb, kmp_uint32 *p_ub,
-                            kmp_int32 *p_st) {
-    kmp_int32 p_lbi = *p_lb;
-    kmp_int32 p_ubi = *p_ub;
-    int ret = __kmpc_dispatch_next_4(loc, gtid, p_last, &p_lbi, &p_ubi, p_st);
-    *p_lb = p_lbi;
-    *p_ub = p_ubi;
-    return ret;
+int __kmpc_dispatch_next_8u(ident_t *loc, kmp_int32 gtid, kmp_int32 *p_last,
+                            kmp_uint64 *p_lb, kmp_uint64 *p_ub,
+                            kmp_int64 *p_st) {
+    (void)loc;
+    (void)gtid;
+    kmp_uint64 lb, ub;
+
+    if (!dispatch_next(p_last, &lb, &ub)) return 0;
+    *p_st = 1;
+    *p_lb = lb;
+    *p_ub = ub;
+    return 1;
 }
 
 #endif  // #ifndef OMPSTATIC_NUMTHREADS
@@ -7,18 +7,6 @@
 #include "dm.h"
 #include "snrt.h"
 
-//================================================================================
-// settings
-//================================================================================
-/**
- * @brief Usually the arguments passed to __kmpc_fork_call would to a malloc
- * with the amount of arguments passed. This is too slow for our case and thus
- * we reserve a chunk of arguments in TCDM and use it. This limits the maximum
- * number of arguments
- *
- */
-#define KMP_FORK_MAX_NARGS 12
-
 //================================================================================
 // data
 //================================================================================
@@ -34,6 +22,11 @@ omp_t omp_p = {
 };
 #endif
 
+#ifdef OMP_SENSE_BARRIER
+// Zero-initialized in DRAM, too big for the TCDM
+static struct snrt_sense_barrier kmpc_sense_barrier;
+#endif
+
 #ifdef OMP_PROF
 #include "printf.h"
 omp_prof_t *omp_prof;
@@ -60,7 +53,8 @@ void omp_init(void) {
 
         omp_p->plainTeam.nbThreads = nbCores;
         omp_p->plainTeam.loop_epoch = 0;
-        omp_p->plainTeam.loop_is_setup = 0;
+        omp_p->plainTeam.loop_claim = 0;
+        omp_p->plainTeam.loop_left = 0;
 
         for (int i = 0; i < sizeof(omp_p->plainTeam.core_epoch) /
                                 sizeof(omp_p->plainTeam.core_epoch[0]);
@@ -68,15 +62,23 @@ void omp_init(void) {
             omp_p->plainTeam.core_epoch[i] = 0;
 
         initTeam(omp_p, &omp_p->plainTeam);
+#ifdef OMP_SENSE_BARRIER
+        omp_p->kmpc_barrier = &kmpc_sense_barrier;
+#else
         omp_p->kmpc_barrier =
             (struct snrt_barrier *)snrt_l1alloc(sizeof(struct snrt_barrier));
         snrt_memset(omp_p->kmpc_barrier, 0, sizeof(struct snrt_barrier));
+#endif
         // Exchange omp pointer with other cluster cores
         omp_p_global = omp_p;
+#else
+#ifdef OMP_SENSE_BARRIER
+        omp_p.kmpc_barrier = &kmpc_sense_barrier;
 #else
         omp_p.kmpc_barrier =
             (struct snrt_barrier *)snrt_l1alloc(sizeof(struct snrt_barrier));
         snrt_memset(omp_p.kmpc_barrier, 0, sizeof(struct snrt_barrier));
+#endif
         // Exchange omp pointer with other cluster cores
         omp_p_global = &omp_p;
 #endif
@@ -100,7 +102,9 @@ void omp_init(void) {
 /**
  * @brief Bootstrap the system for the use of the OpenMP runtime
  * Bootstrap: Core 0 inits the event unit and all other cores enter it while
- * core 0 waits for the queue to be full of workers
+ * core 0 waits until all workers are counted in the event loop. A counted
+ * worker has taken its generation snapshot, so the first job cannot be missed
+ * and core 0 does not wait for the workers to poll out their spin budget.
  * Park DM core
  *
  * Use: if(snrt_omp_bootstrap(core_idx)) return 0;
@@ -114,7 +118,8 @@ unsigned __attribute__((noinline)) snrt_omp_bootstrap(uint32_t core_idx) {
     if (core_idx == 0) {
         // master hart initializes event unit and runtime
         snrt_cluster_hw_barrier();
-        while (eu_get_workers_in_wfi() != (snrt_cluster_compute_core_num() - 1))
+        while (eu_get_workers_in_loop() !=
+               (snrt_cluster_compute_core_num() - 1))
             ;
         return 0;
     } else if (snrt_is_dm_core()) {
@@ -85,7 +85,8 @@ void _snrt_init_team(uint32_t cluster_core_id, uint32_t cluster_core_num,
         (uint32_t *)(spm_start + bootdata->tcdm_size +
                      CACHEPOOL_PERIPHERAL_CL_CLINT_SET_REG_OFFSET);
 
-    // Init allocator
-    snrt_alloc_init(team, sizeof(struct putc_buffer));
+    // Init allocator, the L3 heap starts after the putc buffers of all harts
+    snrt_alloc_init(team, (bootdata->hartid_base + bootdata->core_count) *
+                              sizeof(struct putc_buffer));
     snrt_int_init(team);
 }
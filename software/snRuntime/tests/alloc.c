@@ -0,0 +1,100 @@
+// Copyright 2020 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+#include <snrt.h>
+
+static volatile uint32_t *blocks[32];
+
+int main() {
+    uint32_t core_idx = snrt_cluster_core_idx();
+    uint32_t core_num = snrt_cluster_core_num();
+    uint32_t errors = 0;
+    snrt_slice_t l1 = snrt_cluster_memory();
+    uint32_t l1_size = (uint32_t)(l1.end - l1.start);
+    // Lines of the region below, a quarter of the L1 but at most 16
+    uint32_t region = snrt_min(16, l1_size / (4 * SNRT_L1_ALLOC_ALIGN));
+
+    // All cores allocate concurrently and must get distinct blocks. The
+    // allocator keeps its block table in the L1 too, so running out is only
+    // an error if the blocks take at most half of it.
+    blocks[core_idx] = snrt_l1alloc(sizeof(uint32_t));
+    if (blocks[core_idx])
+        *blocks[core_idx] = core_idx;
+    else
+        errors += core_num * SNRT_L1_ALLOC_ALIGN <= l1_size / 2;
+    snrt_cluster_hw_barrier();
+    for (uint32_t i = 0; i < core_num; i++)
+        errors += blocks[i] && *blocks[i] != i;
+    snrt_cluster_hw_barrier();
+    snrt_l1free((void *)blocks[core_idx]);
+    snrt_cluster_hw_barrier();
+
+    if (core_idx != 0) return errors;
+
+    // The freed blocks sit in the free lists of all cores, start over
+    snrt_l1alloc_reset();
+
+    // Allocations are cacheline aligned
+    uint32_t *a = snrt_l1alloc(4);
+    uint32_t *b = snrt_l1alloc(SNRT_L1_ALLOC_ALIGN + 4);
+    uint32_t *c = snrt_l1alloc(4);
+    errors += !a || !b || !c;
+    errors += ((uint32_t)a | (uint32_t)b | (uint32_t)c) &
+              (SNRT_L1_ALLOC_ALIGN - 1);
+
+    // A freed block is reused by the next request of the same size class
+    snrt_l1free(b);
+    uint32_t *d = snrt_l1alloc(2 * SNRT_L1_ALLOC_ALIGN);
+    errors += (d != b);
+
+    // Freeing the topmost block returns it to the pool
+    snrt_l1free(c);
+    uint32_t *e = snrt_l1alloc(SNRT_L1_ALLOC_ALIGN);
+    errors += (e != c);
+
+    snrt_l1free(a);
+    snrt_l1free(d);
+    snrt_l1free(e);
+
+    // Releasing a region drops its blocks, including freed ones
+    snrt_l1_mark_t mark = snrt_l1_mark();
+    uint32_t *f = snrt_l1alloc(region * SNRT_L1_ALLOC_ALIGN);
+    uint32_t *g = snrt_l1alloc(4);
+    errors += !f || !g;
+    snrt_l1free(f);
+    snrt_l1_release(mark);
+    errors += (snrt_l1_mark().arena != mark.arena);
+    errors += (snrt_l1_mark().pool != mark.pool);
+    // f is carved again instead of popped from a stale free list
+    errors += (snrt_l1alloc(region * SNRT_L1_ALLOC_ALIGN) != f);
+    errors += (snrt_l1_mark().arena == mark.arena &&
+               snrt_l1_mark().pool == mark.pool);
+    snrt_l1_release(mark);
+
+    // Freed L3 neighbours coalesce and serve a bigger request
+    uint32_t *x = snrt_l3alloc(64);
+    uint32_t *y = snrt_l3alloc(64);
+    uint32_t *z = snrt_l3alloc(64);
+    errors += !x || !y || !z;
+    size_t peak = snrt_l3alloc_peak();
+    snrt_l3free(x);
+    snrt_l3free(y);
+    uint32_t *w = snrt_l3alloc(128);
+    errors += (w != x);
+    errors += (snrt_l3alloc_peak() != peak);
+    snrt_l3free(w);
+    snrt_l3free(z);
+
+    // Banked chunks start on the lowest requested bank of the tile
+    uint32_t tile = snrt_cluster_tile_num() - 1;
+    uint32_t banks = core_num / snrt_cluster_tile_num();
+    uint32_t *v = snrt_l1alloc_banked(256, tile, 0x6);
+    errors += !v;
+    errors += (snrt_l1d_bank(v) != tile * banks + 1);
+    snrt_l1free_banked(v);
+
+    // Requests beyond the heap fail
+    errors += (snrt_l3alloc(0x40000000) != 0);
+
+    return errors;
+}
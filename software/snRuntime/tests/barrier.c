@@ -4,6 +4,8 @@
 #include <snrt.h>
 
 static volatile uint32_t *sink = (void *)0xF1230000;
+static struct snrt_sense_barrier sense_barrier;
+static struct snrt_subteam half;
 
 int main() {
     uint32_t core_id = snrt_cluster_core_idx();
@@ -23,5 +25,46 @@ int main() {
         }
     }
     snrt_cluster_hw_barrier();
-    return core_id == 0 ? core_num -= *x : 0;
+
+    // Same with the software barrier
+    for (uint32_t i = 0; i < core_num; i++) {
+        snrt_cluster_sw_barrier();
+        if (i == core_id) {
+            *x += 1;
+        }
+    }
+    snrt_cluster_sw_barrier();
+
+    // Same with the sense-reversing barrier
+    for (uint32_t i = 0; i < core_num; i++) {
+        snrt_sense_barrier(&sense_barrier, core_num);
+        if (i == core_id) {
+            *x += 1;
+        }
+    }
+    snrt_sense_barrier(&sense_barrier, core_num);
+
+    // Same with the split-phase barrier
+    for (uint32_t i = 0; i < core_num; i++) {
+        uint32_t token = snrt_barrier_arrive();
+        snrt_barrier_wait(token);
+        if (i == core_id) {
+            *x += 1;
+        }
+    }
+    snrt_barrier_wait(snrt_barrier_arrive());
+
+    // Only the lower half of the cores syncs, the others have left
+    uint32_t half_num = core_num / 2;
+    snrt_subteam_init_range(&half, 0, half_num);
+    if (snrt_subteam_is_member(&half)) {
+        for (uint32_t i = 0; i < half_num; i++) {
+            snrt_subteam_barrier(&half);
+            if (i == core_id) {
+                *x += 1;
+            }
+        }
+        snrt_subteam_barrier(&half);
+    }
+    return core_id == 0 ? 4 * core_num + half_num - *x : 0;
 }
@@ -0,0 +1,143 @@
+// Copyright 2020 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+// Characterizes the DMA between the main memory and L1. The DM core sweeps
+// transfer size, source stride, source alignment and the number of compute
+// cores that load from L1 at the same time, and prints one parseable line per
+// configuration with the achieved bytes/cycle. The CachePool peripheral has no
+// DMA perf counters, so the timing relies on mcycle of the DM core alone.
+// Transfer sizes are capped to what the L1 pool can hold, which is only a
+// fraction of its 2 KiB on the default configuration.
+
+#include <snrt.h>
+
+#include "encoding.h"
+#include "printf.h"
+
+// Transfers per measurement, issued back to back
+#define DMA_BENCH_ROUNDS 4
+// Biggest transfer in bytes, if the L1 pool can hold it
+#define DMA_BENCH_MAX_SIZE 8192
+// Row size in bytes of the 2D transfers
+#define DMA_BENCH_ROW 256
+// Biggest stride in rows of the 2D transfers
+#define DMA_BENCH_MAX_STRIDE 4
+// Words the loading compute cores stream over in L1, shared by all of them
+#define DMA_BENCH_LOAD_WORDS 64
+
+static const uint32_t sizes[] = {64, 256, 1024, 4096, DMA_BENCH_MAX_SIZE};
+static const uint32_t strides[] = {1, 2, DMA_BENCH_MAX_STRIDE};
+static const uint32_t aligns[] = {0, 4, 32};
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof(a[0]))
+
+static uint8_t *volatile l1_buf;
+static uint32_t *volatile l1_load;
+// Biggest transfer the L1 buffer holds, 0 if the setup failed
+static volatile uint32_t bench_size;
+// Set by the DM core once a measurement is over
+static volatile uint32_t bench_stop;
+static volatile uint32_t sink;
+
+/// Keep the L1 busy with loads until the DM core is done
+static void load_l1(void) {
+    volatile uint32_t *v = l1_load;
+    uint32_t sum = 0;
+    while (!bench_stop)
+        for (uint32_t i = 0; i < DMA_BENCH_LOAD_WORDS; i++) sum += v[i];
+    sink = sum;
+}
+
+/// Time DMA_BENCH_ROUNDS transfers of `size` bytes as rows of `row` bytes
+static uint32_t measure(uint8_t *dst, const uint8_t *src, uint32_t size,
+                        uint32_t row, uint32_t dst_stride,
+                        uint32_t src_stride) {
+    uint32_t start = read_csr(mcycle);
+    for (uint32_t r = 0; r < DMA_BENCH_ROUNDS; r++) {
+        if (row == size)
+            snrt_dma_start_1d(dst, src, size);
+        else
+            snrt_dma_start_2d(dst, src, row, dst_stride, src_stride,
+                              size / row);
+    }
+    snrt_dma_wait_all();
+    return read_csr(mcycle) - start;
+}
+
+static void report(const char *dir, uint32_t size, uint32_t stride,
+                   uint32_t align, uint32_t load, uint32_t cycles) {
+    uint32_t bytes = size * DMA_BENCH_ROUNDS;
+    printf("dma dir=%s size=%u stride=%u align=%u load=%u cycles=%u "
+           "bytes_per_cycle_x100=%u\n",
+           dir, size, stride, align, load, cycles, 100 * bytes / cycles);
+}
+
+/// Number of loading cores after `load`: 0, 1, 2, 4, ... and finally all
+/// `num_compute` cores, returns more than `num_compute` once the sweep is over
+static uint32_t next_load(uint32_t load, uint32_t num_compute) {
+    if (load == num_compute) return num_compute + 1;
+    return snrt_min(load ? 2 * load : 1, num_compute);
+}
+
+int main() {
+    uint32_t cid = snrt_cluster_core_idx();
+    uint32_t num_compute = snrt_cluster_compute_core_num();
+    int dm = snrt_is_dm_core();
+    uint8_t *l3_buf = 0;
+
+    if (snrt_cluster_idx() != 0) return 0;
+
+    if (dm) {
+        uint32_t size = DMA_BENCH_MAX_SIZE;
+        l1_load = snrt_l1alloc(DMA_BENCH_LOAD_WORDS * 4);
+        l3_buf = snrt_l3alloc(DMA_BENCH_MAX_STRIDE * DMA_BENCH_MAX_SIZE + 64);
+        // Halve the L1 buffer until it fits next to the runtime's data
+        while (size >= sizes[0] && !(l1_buf = snrt_l1alloc(size))) size /= 2;
+        if (!l1_load || !l3_buf || !l1_buf) {
+            printf("dma_bench: out of memory\n");
+            size = 0;
+        }
+        bench_size = size;
+    }
+    snrt_cluster_hw_barrier();
+    if (!bench_size) return 1;
+
+    // Every core walks the same sweep, the first `load` compute cores load
+    // from L1 while the DM core measures
+    for (uint32_t load = 0; load <= num_compute;
+         load = next_load(load, num_compute)) {
+        for (uint32_t s = 0; s < ARRAY_LEN(sizes); s++) {
+            for (uint32_t st = 0; st < ARRAY_LEN(strides); st++) {
+                for (uint32_t a = 0; a < ARRAY_LEN(aligns); a++) {
+                    uint32_t size = sizes[s];
+                    uint32_t stride = strides[st];
+                    uint32_t row = stride == 1 ? size
+                                               : snrt_min(size, DMA_BENCH_ROW);
+                    if (size > bench_size) continue;
+
+                    bench_stop = 0;
+                    snrt_cluster_hw_barrier();
+                    if (dm) {
+                        uint8_t *far = l3_buf + aligns[a];
+                        uint8_t *near = l1_buf;
+                        uint32_t cycles;
+
+                        cycles = measure(near, far, size, row, row,
+                                         row * stride);
+                        report("l3-l1", size, stride, aligns[a], load, cycles);
+                        cycles = measure(far, near, size, row, row * stride,
+                                         row);
+                        report("l1-l3", size, stride, aligns[a], load, cycles);
+                        bench_stop = 1;
+                    } else if (cid < load) {
+                        load_l1();
+                    }
+                    snrt_cluster_hw_barrier();
+                }
+            }
+        }
+    }
+
+    return 0;
+}
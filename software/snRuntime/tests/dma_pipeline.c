@@ -0,0 +1,69 @@
+// Copyright 2020 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <snrt.h>
+
+#define ROWS 8
+#define COLS 16
+#define TILE_ROWS 2
+
+// Matrices in the main memory, streamed by row blocks
+uint32_t src[ROWS][COLS];
+uint32_t dst[ROWS][COLS];
+
+// Double every element of a tile in place and count the tiles seen
+static void scale(void *buf, uint32_t tile, void *arg) {
+    uint32_t *v = buf;
+    for (uint32_t i = 0; i < TILE_ROWS * COLS; i++) v[i] *= 2;
+    *(uint32_t *)arg += tile + 1;
+}
+
+int main() {
+    if (snrt_global_core_idx() != 8) return 0;  // only DMA core
+    uint32_t errors = 0;
+
+    for (uint32_t nbufs = 2; nbufs <= SNRT_DMA_PIPELINE_MAX_BUFS; nbufs++) {
+        uint32_t bufs[SNRT_DMA_PIPELINE_MAX_BUFS][TILE_ROWS * COLS];
+        uint32_t seen = 0;
+        for (uint32_t i = 0; i < ROWS; i++) {
+            for (uint32_t j = 0; j < COLS; j++) {
+                src[i][j] = i * COLS + j;
+                dst[i][j] = 0;
+            }
+        }
+
+        struct snrt_dma_pipeline p = {
+            .src = src,
+            .dst = dst,
+            .src_tile_stride = sizeof(src[0]) * TILE_ROWS,
+            .dst_tile_stride = sizeof(dst[0]) * TILE_ROWS,
+            .size = sizeof(src[0]),
+            .src_stride = sizeof(src[0]),
+            .dst_stride = sizeof(dst[0]),
+            .repeat = TILE_ROWS,
+            .num_tiles = ROWS / TILE_ROWS,
+            .num_bufs = nbufs,
+            .compute = scale,
+            .arg = &seen,
+        };
+        for (uint32_t b = 0; b < nbufs; b++) p.buf[b] = bufs[b];
+        errors += snrt_dma_pipeline_run(&p) != 0;
+
+        // Every tile was computed, 1 + 2 + ... + num_tiles
+        errors += (seen != (ROWS / TILE_ROWS) * (ROWS / TILE_ROWS + 1) / 2);
+        for (uint32_t i = 0; i < ROWS; i++) {
+            for (uint32_t j = 0; j < COLS; j++) {
+                errors += (dst[i][j] != 2 * (i * COLS + j));
+            }
+        }
+    }
+
+    // Buffer counts out of range are rejected without touching any tile
+    struct snrt_dma_pipeline bad = {.num_tiles = 1, .num_bufs = 0};
+    errors += snrt_dma_pipeline_run(&bad) != -1;
+    bad.num_bufs = SNRT_DMA_PIPELINE_MAX_BUFS + 1;
+    errors += snrt_dma_pipeline_run(&bad) != -1;
+
+    return errors;
+}
@@ -0,0 +1,61 @@
+// Copyright 2020 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <snrt.h>
+
+#define PLANES 3
+#define ROWS 4
+#define COLS 8
+
+uint32_t src[PLANES][ROWS][COLS];
+uint32_t dst[PLANES][ROWS][COLS];
+
+static void reset(void) {
+    for (uint32_t p = 0; p < PLANES; p++)
+        for (uint32_t i = 0; i < ROWS; i++)
+            for (uint32_t j = 0; j < COLS; j++) {
+                src[p][i][j] = (p * ROWS + i) * COLS + j;
+                dst[p][i][j] = 0;
+            }
+}
+
+int main() {
+    if (snrt_global_core_idx() != 8) return 0;  // only DMA core
+    uint32_t errors = 0;
+
+    // 3D: the first half of every row of every plane
+    reset();
+    snrt_dma_wait(snrt_dma_start_3d(dst, src, sizeof(uint32_t) * COLS / 2,
+                                    sizeof(dst[0][0]), sizeof(src[0][0]), ROWS,
+                                    sizeof(dst[0]), sizeof(src[0]), PLANES));
+    for (uint32_t p = 0; p < PLANES; p++)
+        for (uint32_t i = 0; i < ROWS; i++)
+            for (uint32_t j = 0; j < COLS; j++)
+                errors += (dst[p][i][j] != (j < COLS / 2 ? src[p][i][j] : 0));
+
+    // Scatter-gather: reverse the order of the planes
+    reset();
+    struct snrt_dma_sg_entry list[PLANES];
+    for (uint32_t p = 0; p < PLANES; p++) {
+        list[p].src = src[p];
+        list[p].dst = dst[PLANES - 1 - p];
+        list[p].size = sizeof(src[0]);
+    }
+    snrt_dma_wait(snrt_dma_start_sg(list, PLANES));
+    for (uint32_t p = 0; p < PLANES; p++)
+        for (uint32_t i = 0; i < ROWS; i++)
+            for (uint32_t j = 0; j < COLS; j++)
+                errors += (dst[PLANES - 1 - p][i][j] != src[p][i][j]);
+
+    // Empty lists and 3D transfers issue nothing and are complete right away
+    reset();
+    snrt_dma_wait(snrt_dma_start_sg(list, 0));
+    snrt_dma_wait(snrt_dma_start_3d(dst, src, sizeof(src[0][0]), 0, 0, 1,
+                                    0, 0, 0));
+    for (uint32_t p = 0; p < PLANES; p++)
+        for (uint32_t i = 0; i < ROWS; i++)
+            for (uint32_t j = 0; j < COLS; j++) errors += (dst[p][i][j] != 0);
+
+    return errors;
+}
@@ -0,0 +1,68 @@
+// Copyright 2020 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+#include <snrt.h>
+
+#define BUF_SIZE (8 * SNRT_MEMCPY_VEC_MIN + SNRT_MEMSET_VEC_MIN)
+
+static uint8_t src[BUF_SIZE + 8];
+static uint8_t dst[BUF_SIZE + 8];
+static uint8_t out[BUF_SIZE] SNRT_UNCACHED;
+
+int main() {
+    if (snrt_cluster_core_idx() != 0) return 0;
+    uint32_t errors = 0;
+
+    for (uint32_t i = 0; i < sizeof(src); i++) src[i] = i * 7 + 1;
+
+    // Sizes around the scalar/vector switch, equally and unequally aligned,
+    // through memcpy and directly through the vector copy
+    const size_t sizes[] = {0, 1, 3, 4, 7, SNRT_MEMCPY_VEC_MIN - 1,
+                            SNRT_MEMCPY_VEC_MIN, SNRT_MEMCPY_VEC_MIN + 5,
+                            BUF_SIZE};
+    for (uint32_t v = 0; v < 2; v++) {
+        for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (uint32_t so = 0; so < 4; so++) {
+                for (uint32_t doff = 0; doff < 4; doff++) {
+                    for (uint32_t i = 0; i < sizeof(dst); i++) dst[i] = 0;
+                    if (v)
+                        snrt_vmemcpy(dst + doff, src + so, sizes[s]);
+                    else
+                        snrt_memcpy(dst + doff, src + so, sizes[s]);
+                    for (uint32_t i = 0; i < sizeof(dst); i++) {
+                        uint8_t gold = (i >= doff && i < doff + sizes[s])
+                                           ? src[i - doff + so]
+                                           : 0;
+                        errors += (dst[i] != gold);
+                    }
+                }
+            }
+        }
+    }
+
+    // Fills around the scalar/vector switch at every alignment
+    const size_t fills[] = {0, 1, 5, SNRT_MEMSET_VEC_MIN - 1,
+                            SNRT_MEMSET_VEC_MIN, BUF_SIZE - 3};
+    for (uint32_t s = 0; s < sizeof(fills) / sizeof(fills[0]); s++) {
+        for (uint32_t doff = 0; doff < 4; doff++) {
+            for (uint32_t i = 0; i < sizeof(dst); i++) dst[i] = 0x5a;
+            snrt_memset(dst + doff, 0xa5, fills[s]);
+            for (uint32_t i = 0; i < sizeof(dst); i++) {
+                uint8_t gold =
+                    (i >= doff && i < doff + fills[s]) ? 0xa5 : 0x5a;
+                errors += (dst[i] != gold);
+            }
+        }
+    }
+
+    // Streaming copies into and out of the uncached region
+    errors += !snrt_is_uncached(out) || snrt_is_uncached(src);
+    snrt_memcpy_stream(out, src + 1, BUF_SIZE, SNRT_STREAM_UNCACHED);
+    for (uint32_t i = 0; i < BUF_SIZE; i++) errors += (out[i] != src[i + 1]);
+    snrt_memcpy_stream(dst, out, BUF_SIZE, SNRT_STREAM_UNCACHED);
+    snrt_memcpy_stream(dst + BUF_SIZE, src, 8, SNRT_STREAM_CACHED);
+    for (uint32_t i = 0; i < BUF_SIZE; i++) errors += (dst[i] != src[i + 1]);
+    for (uint32_t i = 0; i < 8; i++) errors += (dst[BUF_SIZE + i] != src[i]);
+
+    return errors;
+}
@@ -0,0 +1,61 @@
+// Copyright 2021 ETH Zurich and University of Bologna.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+// Runs explicit tasks joined with taskwait, a nested parallel region and a
+// reduction on the OpenMP runtime and checks their results.
+
+#include <snrt.h>
+
+#include "dm.h"
+#include "omp.h"
+
+static uint32_t fib(uint32_t n) {
+    uint32_t a, b;
+    if (n < 2) return n;
+#pragma omp task shared(a)
+    a = fib(n - 1);
+#pragma omp task shared(b)
+    b = fib(n - 2);
+#pragma omp taskwait
+    return a + b;
+}
+
+int main() {
+    uint32_t core_idx = snrt_cluster_core_idx();
+    uint32_t errors = 0;
+
+    __snrt_omp_bootstrap(core_idx);
+
+    // Outside of parallel regions the master is a team of one
+    errors += omp_get_thread_num() != 0 || omp_get_num_threads() != 1;
+
+    // Tasks spawned by one thread are run by the whole team
+    uint32_t f = 0;
+#pragma omp parallel
+    {
+        if (omp_get_thread_num() == 0) f = fib(12);
+    }
+    errors += f != 144;
+
+    // A nested region runs serialized with a team of one, the enclosing
+    // thread gets its number back afterwards
+    uint32_t threads = 0, nested = 0;
+#pragma omp parallel reduction(+ : threads, nested)
+    {
+        uint32_t outer = omp_get_thread_num();
+        threads++;
+#pragma omp parallel
+        nested += omp_get_thread_num() == 0 && omp_get_num_threads() == 1;
+        nested += omp_get_thread_num() == outer;
+    }
+    errors += threads == 0 || nested != 2 * threads;
+
+    uint32_t sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+    for (uint32_t i = 1; i <= 100; i++) sum += i;
+    errors += sum != 5050;
+
+    __snrt_omp_destroy(core_idx);
+    return errors;
+}
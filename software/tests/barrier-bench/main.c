@@ -0,0 +1,131 @@
+// Copyright 2025 ETH Zurich and University of Bologna.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the cost of the runtime barriers. In every round, core `i` enters
+// the barrier `i * skew` cycles after the others were aligned. We record
+// entry and exit cycles of all cores and report
+//   latency: last exit - last entry, the round-trip cost of the barrier
+//   skew:    last exit - first exit, how far apart the cores are released
+// averaged over all rounds, one parseable line per barrier and skew.
+
+#include <benchmark.h>
+#include <omp.h>
+#include <snrt.h>
+#include <stdio.h>
+
+// Rounds per measurement, the first one warms up the caches
+#ifndef BARRIER_ROUNDS
+#define BARRIER_ROUNDS 16
+#endif
+// Artificial arrival skew in cycles between neighbouring cores
+#ifndef BARRIER_SKEW
+#define BARRIER_SKEW 64
+#endif
+
+extern void __kmpc_barrier(ident_t *loc, kmp_int32 tid);
+
+enum barrier_kind { HW, SW, GLOBAL, SENSE, SPLIT, KMPC, NUM_KINDS };
+static const char *barrier_name[NUM_KINDS] = {"hw",    "sw",    "global",
+                                              "sense", "split", "kmpc"};
+
+static struct snrt_sense_barrier sense_barrier;
+
+// Entry and exit cycle of each core, one cacheline per core
+static struct {
+  volatile uint32_t enter;
+  volatile uint32_t exit;
+} __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES)))
+stamp[SNRT_CLUSTER_MAX_CORES];
+
+static inline void barrier_run(enum barrier_kind kind, uint32_t num) {
+  switch (kind) {
+  case HW:
+    snrt_cluster_hw_barrier();
+    break;
+  case SW:
+    snrt_cluster_sw_barrier();
+    break;
+  case GLOBAL:
+    snrt_global_barrier();
+    break;
+  case SENSE:
+    snrt_sense_barrier(&sense_barrier, num);
+    break;
+  case SPLIT:
+    snrt_barrier_wait(snrt_barrier_arrive());
+    break;
+  case KMPC:
+    __kmpc_barrier(0, 0);
+    break;
+  default:
+    break;
+  }
+}
+
+int main() {
+  const uint32_t num_cores = snrt_cluster_core_num();
+  const uint32_t cid = snrt_cluster_core_idx();
+
+  // The OpenMP team only holds the compute cores
+  omp_init();
+  snrt_cluster_hw_barrier();
+
+  const uint32_t skews[2] = {0, BARRIER_SKEW};
+
+  for (uint32_t kind = 0; kind < NUM_KINDS; kind++) {
+    const uint32_t num =
+        (kind == KMPC) ? snrt_cluster_compute_core_num() : num_cores;
+    const uint32_t active = cid < num;
+
+    for (uint32_t s = 0; s < 2; s++) {
+      uint32_t latency = 0;
+      uint32_t skew = 0;
+
+      for (uint32_t r = 0; r < BARRIER_ROUNDS; r++) {
+        // Align all cores, then stagger their arrival
+        snrt_cluster_hw_barrier();
+        if (active) {
+          cachepool_wait(cid * skews[s]);
+          stamp[cid].enter = benchmark_get_cycle();
+          barrier_run(kind, num);
+          stamp[cid].exit = benchmark_get_cycle();
+        }
+        snrt_cluster_hw_barrier();
+
+        if (cid == 0 && r > 0) {
+          uint32_t last_enter = 0, first_exit = (uint32_t)-1, last_exit = 0;
+          for (uint32_t i = 0; i < num; i++) {
+            last_enter = snrt_max(last_enter, stamp[i].enter);
+            last_exit = snrt_max(last_exit, stamp[i].exit);
+            first_exit = stamp[i].exit < first_exit ? stamp[i].exit : first_exit;
+          }
+          latency += last_exit - last_enter;
+          skew += last_exit - first_exit;
+        }
+      }
+
+      if (cid == 0) {
+        printf("barrier=%s cores=%u tiles=%u arrival_skew=%u latency=%u "
+               "release_skew=%u\n",
+               barrier_name[kind], num, snrt_cluster_tile_num(), skews[s],
+               latency / (BARRIER_ROUNDS - 1), skew / (BARRIER_ROUNDS - 1));
+      }
+    }
+  }
+
+  snrt_cluster_hw_barrier();
+  return 0;
+}
@@ -44,12 +44,16 @@ static inline int fp_check(const float a, const float b) {
 // 512  -> 32
 // 1024 -> 64
 
+// Cores taking part in the FFT
+static struct snrt_subteam active;
+
 int main() {
   const int measure_iter = 2;
 
   // twiddle layout: [re_p1, im_p1, re_p2, im_p2]
   const uint32_t num_cores = snrt_cluster_core_num();
   const uint32_t cid = snrt_cluster_core_idx();
+  snrt_subteam_init_range(&active, 0, active_cores);
   
   snrt_cluster_hw_barrier();
   const uint32_t NFFTpc = NFFT / active_cores;
@@ -106,8 +110,8 @@ int main() {
       timer_tmp = benchmark_get_cycle();
     }
 
-    for (uint32_t i = 0; i < log2_nfft1; i ++) {
-      if (cid < active_cores) {
+    if (cid < active_cores) {
+      for (uint32_t i = 0; i < log2_nfft1; i ++) {
         fft_p1(src_p1, buf_p1, twi_p1, NFFT, NTWI_P1, cid, active_cores, i, len);
         // each round will use half the twiddle than previous round
         // the first round needs re/im NFFT/2 twiddles
@@ -115,13 +119,12 @@ int main() {
         buf_p1 = (i & 1) ? buffer_dram : samples_dram;
         twi_p1 += (NFFT >> (i+1));
         p2_switch = (i & 1);
-      }
 
-      // In first part of calculation, we need barrier after each round
-      snrt_cluster_hw_barrier();
-    }
+        // In first part of calculation, we need barrier after each round
+        // Only the active cores share data, idle ones skip ahead
+        snrt_subteam_barrier(&active);
+      }
 
-    if (cid < active_cores) {
       // Fall back into the single-core case
       // Each core just do a FFT on (NFFT >> stage_in_P1) data
       if (p2_switch) {
@@ -107,17 +107,10 @@ int main() {
       stop_kernel();
     }
 
-    // Final reduction
-    if (cid == 0) {
-      // timer_tmp = benchmark_get_cycle() - timer_tmp;
-      for (uint32_t i = 1; i < num_cores; ++i)
-        acc += result[i];
-      result[0] = acc;
-
-#ifdef DEBUG
-      printf("results:%u\n", result[0]);
-#endif
-    }
+    // Final reduction: every core adds its partial sum to the one of core 0
+    // with a single amoadd, instead of core 0 summing them up one by one
+    if (cid != 0)
+      __atomic_fetch_add(&result[0], acc, __ATOMIC_RELAXED);
 
   }
 
@@ -0,0 +1,111 @@
+// Copyright 2025 ETH Zurich and University of Bologna.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the runtime vector copy against scalar byte and word loops over
+// copy sizes and source/destination misalignment. Core 0 copies between two
+// DRAM buffers, the other cores idle. Every configuration is run twice, the
+// second, warm run is reported as one parseable line per copy routine.
+
+#include <benchmark.h>
+#include <snrt.h>
+#include <stdio.h>
+
+#ifndef MEMCPY_MAX_SIZE
+#define MEMCPY_MAX_SIZE 4096
+#endif
+
+static uint8_t src[MEMCPY_MAX_SIZE + 4]
+    __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES)));
+static uint8_t dst[MEMCPY_MAX_SIZE + 4]
+    __attribute__((aligned(SNRT_L1D_CACHELINE_BYTES)));
+
+static void __attribute__((noinline))
+scalar_copy8(void *d, const void *s, size_t n) {
+  volatile uint8_t *d8 = d;
+  const uint8_t *s8 = s;
+  for (size_t i = 0; i < n; i++) d8[i] = s8[i];
+}
+
+// Word loop as in the RLC kernel, only valid for equally aligned buffers
+static void __attribute__((noinline))
+scalar_copy32(void *d, const void *s, size_t n) {
+  volatile uint32_t *d32 = d;
+  const uint32_t *s32 = s;
+  size_t i;
+  for (i = 0; i < n / 4; i++) d32[i] = s32[i];
+  for (i *= 4; i < n; i++) ((volatile uint8_t *)d)[i] = ((const uint8_t *)s)[i];
+}
+
+enum copy_kind { SCALAR8, SCALAR32, MEMCPY, VMEMCPY, NUM_KINDS };
+static const char *copy_name[NUM_KINDS] = {"scalar8", "scalar32", "memcpy",
+                                           "vmemcpy"};
+
+static void run(enum copy_kind kind, void *d, const void *s, size_t n) {
+  switch (kind) {
+  case SCALAR8:
+    scalar_copy8(d, s, n);
+    break;
+  case SCALAR32:
+    scalar_copy32(d, s, n);
+    break;
+  case MEMCPY:
+    snrt_memcpy(d, s, n);
+    break;
+  case VMEMCPY:
+    snrt_vmemcpy(d, s, n);
+    break;
+  default:
+    break;
+  }
+}
+
+int main() {
+  const uint32_t cid = snrt_cluster_core_idx();
+  const size_t sizes[] = {16, 64, 256, 1360, MEMCPY_MAX_SIZE};
+  const uint32_t offsets[][2] = {{0, 0}, {1, 1}, {0, 1}, {3, 2}};
+  uint32_t errors = 0;
+
+  if (cid == 0) {
+    for (uint32_t i = 0; i < sizeof(src); i++) src[i] = (uint8_t)(i * 13 + 5);
+
+    for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      for (uint32_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+        const uint32_t doff = offsets[o][0], soff = offsets[o][1];
+        for (uint32_t kind = 0; kind < NUM_KINDS; kind++) {
+          // The word loop needs a common alignment
+          if (kind == SCALAR32 && doff != soff)
+            continue;
+          uint32_t cycles = 0;
+          for (uint32_t r = 0; r < 2; r++) {
+            size_t start = benchmark_get_cycle();
+            run(kind, dst + doff, src + soff, sizes[s]);
+            cycles = benchmark_get_cycle() - start;
+          }
+          for (uint32_t i = 0; i < sizes[s]; i++)
+            errors += (dst[doff + i] != src[soff + i]);
+          printf("memcpy=%s size=%u dst_off=%u src_off=%u cycles=%u "
+                 "bytes_per_cycle_x100=%u\n",
+                 copy_name[kind], sizes[s], doff, soff, cycles,
+                 100 * sizes[s] / cycles);
+        }
+      }
+    }
+    printf("errors=%u\n", errors);
+  }
+
+  snrt_cluster_hw_barrier();
+  return errors;
+}
@@ -167,13 +167,9 @@ void mm_free(void *p) {
     // DEBUG_PRINTF_LOCK_RELEASE(&printf_lock);
 }
 
-/* mm_memset: Custom implementation that fills dest with the specified value. */
+/* mm_memset: Fills dest with the specified value, vectorized by the runtime. */
 void *mm_memset(void *dest, int value, size_t count) {
-    unsigned char *ptr = (unsigned char *)dest;
-    while(count--) {
-        *ptr++ = (unsigned char)value;
-    }
-    return dest;
+    return snrt_memset(dest, value, count);
 }
 
 /* mm_cleanup: Reset the memory management state. */